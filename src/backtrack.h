@@ -0,0 +1,137 @@
+// backtracking solver on incrementally maintained used-value masks: one candidate set per row, column and region records the
+// values placed there, so a cell's legal values are a few ORs away. each node fills the empty cell with the fewest legal values
+// (minimum remaining values), tries only those values, and never re-validates a full board.
+
+// search state of the mask solver
+typedef struct {
+	int** iBoard;
+	candidateSet used[3*64];  // values placed in each unit, indexed like units (rows, then columns, then regions)
+	int* emptyCells;  // cells still to fill; the first `depth` entries have been filled, in the order they were chosen
+	int numEmpty;
+} maskEngine;
+
+/**
+ * get the values that may legally be placed in a cell
+ * @param n: the board size, a compile-time constant in each specialized copy
+ * @param engine: the mask solver state
+ * @param cell: the index of the cell
+ * @returns: the candidate set of values not yet used in the cell's row, column or region
+ */
+static inline candidateSet maskLegalValues(const int n, maskEngine* engine, int cell) {
+	uint16_t* unitsOfCell = &cellUnits[cell*3];
+	return candAllSized(n) & ~(engine->used[unitsOfCell[0]] | engine->used[unitsOfCell[1]] | engine->used[unitsOfCell[2]]);
+}
+
+/**
+ * find the unfilled cell with the fewest legal values, and move it to position depth of the empty cell list
+ * @param n: the board size, a compile-time constant in each specialized copy
+ * @param k: the region size (unused; present to match the other sized kernels)
+ * @param engine: the mask solver state
+ * @param depth: the number of cells filled so far
+ * @returns: the chosen cell's legal values (empty if some cell has none, in which case this branch is dead)
+ */
+SIZED_KERNEL candidateSet maskChooseCellKernel(const int n, const int k, maskEngine* engine, int depth) {
+	int* emptyCells = engine->emptyCells;
+	int best = depth, bestCount = n+1;
+	candidateSet bestValues = 0;
+	for (int i = depth; i < engine->numEmpty; ++i) {
+		candidateSet values = maskLegalValues(n, engine, emptyCells[i]);
+		int count = candCount(values);
+		if (count < bestCount) {
+			best = i;
+			bestCount = count;
+			bestValues = values;
+			// a cell with no values is a dead end, and one with a single value is forced; either way, look no further
+			if (count <= 1) break;
+		}
+	}
+	int swp = emptyCells[depth];
+	emptyCells[depth] = emptyCells[best];
+	emptyCells[best] = swp;
+	return bestValues;
+}
+
+/**
+ * find the unfilled cell with the fewest legal values using the kernel specialized for the current board size
+ * @param engine: the mask solver state
+ * @param depth: the number of cells filled so far
+ * @returns: the chosen cell's legal values (empty if some cell has none)
+ */
+candidateSet maskChooseCell(maskEngine* engine, int depth) {
+	DISPATCH_BOARD_SIZE(maskChooseCellKernel, engine, depth);
+}
+
+/**
+ * flip a value in or out of the used-value masks of a cell's row, column and region
+ * @param engine: the mask solver state
+ * @param cell: the index of the cell
+ * @param bit: the value's candidate set bit
+ */
+static inline void maskToggle(maskEngine* engine, int cell, candidateSet bit) {
+	uint16_t* unitsOfCell = &cellUnits[cell*3];
+	engine->used[unitsOfCell[0]] ^= bit;
+	engine->used[unitsOfCell[1]] ^= bit;
+	engine->used[unitsOfCell[2]] ^= bit;
+}
+
+/**
+ * core recursive internal function for the mask solver; fills in the most constrained cell with each of its legal values in turn
+ * @param engine: the mask solver state
+ * @param depth: the number of cells filled so far
+ * @returns: whether the board was solved (true) or this branch is a dead end (false)
+ */
+bool serialMaskSolverInternal(maskEngine* engine, int depth) {
+	++totalNodes;
+	// stop early if another rank has already found a solution
+	if (cancelRequested()) return false;
+	// base case: every placement was legal, so a full board is solved
+	if (depth == engine->numEmpty) return true;
+	STAT_MAX(rankStats, maxDepth, depth+1);
+
+	candidateSet values = maskChooseCell(engine, depth);
+	int cell = engine->emptyCells[depth];
+	for (; values != 0; values &= values-1) {
+		candidateSet bit = values & -values;
+		maskToggle(engine, cell, bit);
+		engine->iBoard[cell/boardSize][cell%boardSize] = candLowest(bit);
+		if (serialMaskSolverInternal(engine, depth+1)) return true;
+		maskToggle(engine, cell, bit);
+	}
+	engine->iBoard[cell/boardSize][cell%boardSize] = 0;
+	STAT_ADD(rankStats, backtracks, 1);
+	return false;
+}
+
+/**
+ * solve the specified board serially by backtracking on used-value masks, filling the most constrained cell first
+ * @param iBoard: 2d array containing the board data
+ * @returns: whether a solution was found (true) or not, either because none exists or because another rank found one first (false)
+ */
+bool serialMaskSolver(int** iBoard) {
+	int numCells = boardSize*boardSize;
+	maskEngine engine;
+	engine.iBoard = iBoard;
+	engine.emptyCells = malloc(numCells*sizeof(int));
+	engine.numEmpty = 0;
+	memset(engine.used, 0, sizeof(engine.used));
+
+	// record the givens, rejecting boards whose givens already repeat a value
+	bool consistent = true;
+	for (int cell = 0; cell < numCells; ++cell) {
+		int val = iBoard[cell/boardSize][cell%boardSize];
+		if (val == 0) {
+			engine.emptyCells[engine.numEmpty++] = cell;
+			continue;
+		}
+		uint16_t* unitsOfCell = &cellUnits[cell*3];
+		if ((engine.used[unitsOfCell[0]] | engine.used[unitsOfCell[1]] | engine.used[unitsOfCell[2]]) & candBit(val))
+			consistent = false;
+		maskToggle(&engine, cell, candBit(val));
+	}
+
+	STAT_TIMER_START(startTime);
+	bool solved = consistent && serialMaskSolverInternal(&engine, 0);
+	STAT_TIMER_ADD(rankStats, busyTime, startTime);
+	free(engine.emptyCells);
+	return solved;
+}
@@ -0,0 +1,250 @@
+// message tags used by the batch solver
+#define BATCH_TAG_RESULTS 1  // worker -> rank 0: results for the worker's previous chunk, doubling as a request for the next one
+#define BATCH_TAG_WORK 2  // rank 0 -> worker: the next chunk of puzzles; an empty chunk means the input is exhausted
+
+// header at the front of every chunk message, followed by one record per puzzle
+typedef struct {
+	long long firstPuzzle;  // input order index of the chunk's first puzzle
+	int numPuzzles;  // number of puzzle records following the header
+} batchHeader;
+
+// a work record is boardSize*boardSize cell values; a result record is the solve time, a solved flag, then the resulting cell values
+#define BATCH_RESULT_CELLS_OFFSET (sizeof(double) + 1)
+
+/**
+ * get the size in bytes of a chunk message
+ * @param numPuzzles: the number of puzzle records in the chunk
+ * @param results: whether the chunk holds result records (true) or work records (false)
+ * @returns: the size of the header plus all records
+ */
+size_t batchChunkBytes(int numPuzzles, bool results) {
+	return sizeof(batchHeader) + (size_t)numPuzzles*((results ? BATCH_RESULT_CELLS_OFFSET : 0) + boardSize*boardSize);
+}
+
+/**
+ * read the next chunk of puzzles from the input file into a work chunk
+ * @param in: the input file, in any puzzle format
+ * @param work: the work chunk buffer to fill, large enough for maxPuzzles records
+ * @param firstPuzzle: the input order index to give the chunk's first puzzle
+ * @param maxPuzzles: the maximum number of puzzles to place in the chunk
+ * @returns: the number of puzzles read, which is 0 once the file is exhausted
+ */
+int batchReadChunk(puzzleReader* in, unsigned char* work, long long firstPuzzle, int maxPuzzles) {
+	int numCells = boardSize*boardSize;
+	batchHeader header = {firstPuzzle, 0};
+	unsigned char* record = work + sizeof(batchHeader);
+	while (header.numPuzzles < maxPuzzles && puzzleReaderNext(in, record)) {
+		record += numCells;
+		++header.numPuzzles;
+	}
+	memcpy(work, &header, sizeof(batchHeader));
+	return header.numPuzzles;
+}
+
+/**
+ * solve every puzzle in a work chunk, in lanes where the board size allows and otherwise with the serial CP solver, timing each one
+ * @param work: the work chunk to solve
+ * @param results: the result chunk buffer to fill, large enough for the work chunk's records
+ */
+void batchSolveChunk(unsigned char* work, unsigned char* results) {
+	int numCells = boardSize*boardSize;
+	batchHeader header;
+	memcpy(&header, work, sizeof(batchHeader));
+	memcpy(results, &header, sizeof(batchHeader));
+	unsigned char* workRecord = work + sizeof(batchHeader);
+	unsigned char* resultRecord = results + sizeof(batchHeader);
+	if (batchLanes && boardSize <= LANE_MAX_BOARD_SIZE) {
+		double solveTimes[header.numPuzzles];
+		laneSolvePuzzles(workRecord, header.numPuzzles, resultRecord + BATCH_RESULT_CELLS_OFFSET, BATCH_RESULT_CELLS_OFFSET + numCells, solveTimes);
+		for (int p = 0; p < header.numPuzzles; ++p)
+			memcpy(resultRecord + p*(BATCH_RESULT_CELLS_OFFSET + numCells), &solveTimes[p], sizeof(double));
+	}
+	else {
+		for (int p = 0; p < header.numPuzzles; ++p) {
+			for (int i = 0; i < numCells; ++i)
+				board[i/boardSize][i%boardSize] = workRecord[i];
+
+			double startTime = MPI_Wtime();
+			serialCPSolver(board);
+			double solveTime = MPI_Wtime() - startTime;
+
+			memcpy(resultRecord, &solveTime, sizeof(double));
+			for (int i = 0; i < numCells; ++i)
+				resultRecord[BATCH_RESULT_CELLS_OFFSET + i] = board[i/boardSize][i%boardSize];
+			workRecord += numCells;
+			resultRecord += BATCH_RESULT_CELLS_OFFSET + numCells;
+		}
+	}
+
+	// validate the whole chunk's solutions in one pass. an unsolved puzzle is reported as given, rather than as whatever partial
+	// board the solver that gave up on it left behind, so the output doesn't depend on which solver ran
+	bool solved[header.numPuzzles];
+	workRecord = work + sizeof(batchHeader);
+	resultRecord = results + sizeof(batchHeader);
+	boardsAreSolved(resultRecord + BATCH_RESULT_CELLS_OFFSET, BATCH_RESULT_CELLS_OFFSET + numCells, header.numPuzzles, solved);
+	for (int p = 0; p < header.numPuzzles; ++p) {
+		unsigned char* record = resultRecord + p*(BATCH_RESULT_CELLS_OFFSET + numCells);
+		record[sizeof(double)] = solved[p];
+		if (!solved[p])
+			memcpy(record + BATCH_RESULT_CELLS_OFFSET, workRecord + (size_t)p*numCells, numCells);
+	}
+}
+
+/**
+ * write each result in a result chunk: the solution board, followed in text files by the solve time and "unsolved" if no solution was found
+ * @param out: the output file
+ * @param results: the result chunk to write
+ * @returns: the number of puzzles in the chunk that were solved
+ */
+int batchWriteChunk(puzzleWriter* out, unsigned char* results) {
+	int numCells = boardSize*boardSize;
+	batchHeader header;
+	memcpy(&header, results, sizeof(batchHeader));
+	unsigned char* record = results + sizeof(batchHeader);
+	int numSolved = 0;
+	char note[64];
+	for (int p = 0; p < header.numPuzzles; ++p) {
+		double solveTime;
+		memcpy(&solveTime, record, sizeof(double));
+		snprintf(note, sizeof(note), " %f%s", solveTime, record[sizeof(double)] ? "" : " unsolved");
+		puzzleWriterPut(out, record + BATCH_RESULT_CELLS_OFFSET, note);
+		numSolved += record[sizeof(double)];
+		record += BATCH_RESULT_CELLS_OFFSET + numCells;
+	}
+	return numSolved;
+}
+
+/**
+ * rank 0's half of the batch solver: stream chunks to whichever worker reports in next, and write results back in input order.
+ * with a single rank, rank 0 solves each chunk itself.
+ * @param in: the input file, in any puzzle format
+ * @param out: the output file
+ * @param chunkSize: the maximum number of puzzles to hand out per request
+ * @param puzzlesPerRank: filled with the number of puzzles solved by each rank
+ * @returns: the total number of puzzles solved
+ */
+long long batchMaster(puzzleReader* in, puzzleWriter* out, int chunkSize, long long* puzzlesPerRank) {
+	unsigned char* work = malloc(batchChunkBytes(chunkSize, false));
+	long long nextPuzzle = 0, numSolved = 0;
+
+	if (numRanks == 1) {
+		unsigned char* results = malloc(batchChunkBytes(chunkSize, true));
+		int numPuzzles;
+		while ((numPuzzles = batchReadChunk(in, work, nextPuzzle, chunkSize)) > 0) {
+			batchSolveChunk(work, results);
+			numSolved += batchWriteChunk(out, results);
+			nextPuzzle += numPuzzles;
+			puzzlesPerRank[0] += numPuzzles;
+		}
+		free(results);
+		free(work);
+		return numSolved;
+	}
+
+	// result chunks that arrived ahead of an earlier, still unfinished chunk wait here until they can be written in order
+	int numPending = 0, pendingCapacity = numRanks;
+	unsigned char** pending = malloc(pendingCapacity*sizeof(unsigned char*));
+	long long nextToWrite = 0;
+	int activeWorkers = numRanks-1;
+	while (activeWorkers > 0) {
+		// receive results (or an initial empty request) from any worker
+		MPI_Status status;
+		int resultBytes;
+		MPI_Probe(MPI_ANY_SOURCE, BATCH_TAG_RESULTS, MPI_COMM_WORLD, &status);
+		MPI_Get_count(&status, MPI_BYTE, &resultBytes);
+		unsigned char* results = malloc(resultBytes);
+		MPI_Recv(results, resultBytes, MPI_BYTE, status.MPI_SOURCE, BATCH_TAG_RESULTS, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+		// hand the worker its next chunk straight away so it isn't kept waiting on our file output
+		int numPuzzles = batchReadChunk(in, work, nextPuzzle, chunkSize);
+		MPI_Send(work, batchChunkBytes(numPuzzles, false), MPI_BYTE, status.MPI_SOURCE, BATCH_TAG_WORK, MPI_COMM_WORLD);
+		nextPuzzle += numPuzzles;
+		if (numPuzzles == 0)
+			--activeWorkers;
+
+		batchHeader header;
+		memcpy(&header, results, sizeof(batchHeader));
+		if (header.numPuzzles == 0) {
+			free(results);
+			continue;
+		}
+		puzzlesPerRank[status.MPI_SOURCE] += header.numPuzzles;
+		if (numPending == pendingCapacity)
+			pending = realloc(pending, (pendingCapacity *= 2)*sizeof(unsigned char*));
+		pending[numPending++] = results;
+
+		// write out every pending chunk that is next in input order
+		for (int i = 0; i < numPending; ++i) {
+			memcpy(&header, pending[i], sizeof(batchHeader));
+			if (header.firstPuzzle != nextToWrite)
+				continue;
+			numSolved += batchWriteChunk(out, pending[i]);
+			nextToWrite += header.numPuzzles;
+			free(pending[i]);
+			pending[i] = pending[--numPending];
+			i = -1;
+		}
+	}
+	free(pending);
+	free(work);
+	return numSolved;
+}
+
+/**
+ * a worker's half of the batch solver: repeatedly report the previous chunk's results to rank 0 and solve the chunk it sends back
+ * @param chunkSize: the maximum number of puzzles rank 0 hands out per request
+ */
+void batchWorker(int chunkSize) {
+	unsigned char* work = malloc(batchChunkBytes(chunkSize, false));
+	unsigned char* results = malloc(batchChunkBytes(chunkSize, true));
+	batchHeader header = {0, 0};
+	memcpy(results, &header, sizeof(batchHeader));
+	while (true) {
+		MPI_Send(results, batchChunkBytes(header.numPuzzles, true), MPI_BYTE, 0, BATCH_TAG_RESULTS, MPI_COMM_WORLD);
+		MPI_Recv(work, batchChunkBytes(chunkSize, false), MPI_BYTE, 0, BATCH_TAG_WORK, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		memcpy(&header, work, sizeof(batchHeader));
+		if (header.numPuzzles == 0)
+			break;
+		batchSolveChunk(work, results);
+	}
+	free(work);
+	free(results);
+}
+
+/**
+ * solve every puzzle in a file using all ranks, with rank 0 handing out chunks of puzzles on demand.
+ * solutions and per-puzzle solve times are written to the output file in input order, and rank 0 reports puzzles/sec across all ranks.
+ * @param inName: the name of the puzzle file, in any puzzle format
+ * @param outName: the name of the file to write results to
+ * @param outFormat: the format to write results in (binary files hold the solutions only)
+ * @param chunkSize: the maximum number of puzzles to hand out per request
+ */
+void batchSolve(char inName[], char outName[], int outFormat, int chunkSize) {
+	puzzleReader in;
+	puzzleWriter out;
+	if (rank == 0) {
+		if (!puzzleReaderOpen(&in, inName) || !puzzleWriterOpen(&out, outName, outFormat))
+			MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+	}
+
+	MPI_Barrier(MPI_COMM_WORLD);
+	double startTime = MPI_Wtime();
+	if (rank == 0) {
+		long long* puzzlesPerRank = calloc(numRanks, sizeof(long long));
+		long long numSolved = batchMaster(&in, &out, chunkSize, puzzlesPerRank);
+		double elapsed = MPI_Wtime() - startTime;
+		long long numPuzzles = 0;
+		for (int i = 0; i < numRanks; ++i)
+			numPuzzles += puzzlesPerRank[i];
+		printf("Solved %lld of %lld puzzles in %fs (%.1f puzzles/sec across %d ranks)\n", numSolved, numPuzzles, elapsed, numPuzzles / elapsed, numRanks);
+		if (batchLanes && boardSize <= LANE_MAX_BOARD_SIZE)
+			printf("propagated %d puzzles at a time in %s lanes\n", LANE_COUNT, laneInstructionSet());
+		for (int i = 0; i < numRanks; ++i)
+			if (puzzlesPerRank[i] > 0) printf("rank %d: %lld puzzles\n", i, puzzlesPerRank[i]);
+		free(puzzlesPerRank);
+		puzzleReaderClose(&in);
+		puzzleWriterClose(&out);
+	}
+	else
+		batchWorker(chunkSize);
+}
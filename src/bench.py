@@ -0,0 +1,89 @@
+import argparse
+import csv
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+# corpora in puzzles/, with the board size they hold and the solvers worth running on them
+# (brute force is left off the corpora where it would run for hours)
+CORPORA = {
+    "easy": (9, ["serialBruteForce", "parallelBruteForce", "serialMask", "serialDLX", "parallelDLX", "serialCP", "parallelCP", "hybridCP", "portfolio"]),
+    "hard": (9, ["serialBruteForce", "parallelBruteForce", "serialMask", "serialDLX", "parallelDLX", "serialCP", "parallelCP", "hybridCP", "portfolio"]),
+    "pathological": (9, ["serialMask", "serialDLX", "parallelDLX", "serialCP", "parallelCP", "hybridCP", "portfolio"]),
+    "hard16": (16, ["serialCP", "parallelCP", "hybridCP", "portfolio"]),
+}
+
+
+def mpirun(args, ranks, extra):
+    cmd = os.environ.get("MPIRUN", "mpirun").split() + ["-np", str(ranks)] + extra + ["./generator"] + args
+    result = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    if result.returncode != 0:
+        sys.exit("command failed: " + " ".join(cmd) + "\n" + result.stdout)
+    return result.stdout
+
+
+def main():
+    parser = argparse.ArgumentParser(description="benchmark every solver over the standard corpora at several rank counts")
+    parser.add_argument("--ranks", default="1,2,4", help="comma separated rank counts to run at")
+    parser.add_argument("--corpora", default=",".join(CORPORA), help="comma separated corpora to run")
+    parser.add_argument("--solvers", default=None, help="comma separated solvers to run (default: every solver suited to each corpus)")
+    parser.add_argument("--weak-puzzles", type=int, default=2000, help="puzzles per rank for the weak scaling batch runs (0 to skip them)")
+    parser.add_argument("--mpi-args", default=os.environ.get("MPIARGS", ""), help="extra arguments for mpirun, e.g. --oversubscribe")
+    parser.add_argument("--out", default="bench_results", help="results are written to OUT.csv and OUT.json")
+    args = parser.parse_args()
+    ranks = [int(r) for r in args.ranks.split(",")]
+    extra = args.mpi_args.split()
+
+    # strong scaling: the same corpus at every rank count
+    rows = []
+    with tempfile.TemporaryDirectory() as tmp:
+        rawCsv = os.path.join(tmp, "raw.csv")
+        for corpus in args.corpora.split(","):
+            size, solvers = CORPORA[corpus]
+            if args.solvers is not None:
+                solvers = [s for s in args.solvers.split(",") if s in solvers]
+            for r in ranks:
+                print("%s on %d ranks" % (corpus, r), flush=True)
+                mpirun(["--size", str(size), "--bench", os.path.join("puzzles", corpus + ".txt"), "--solvers", ",".join(solvers), "--output", rawCsv], r, extra)
+        with open(rawCsv) as f:
+            rows = list(csv.DictReader(f))
+
+        # weak scaling: batch throughput with a fixed number of puzzles per rank
+        weak = []
+        for r in ranks if args.weak_puzzles > 0 else []:
+            puzzles = os.path.join(tmp, "weak.txt")
+            mpirun(["--generate", str(args.weak_puzzles*r), "--seed", "1", "--output", puzzles], r, extra)
+            output = mpirun(["--batch", puzzles, "--output", os.path.join(tmp, "solutions.txt")], r, extra)
+            rate = float(re.search(r"\(([\d.]+) puzzles/sec", output).group(1))
+            weak.append({"ranks": r, "puzzles": args.weak_puzzles*r, "puzzles_per_sec": rate})
+
+    # strong scaling efficiency: a solver's time on one rank over p times its time on p ranks
+    for row in rows:
+        base = [b for b in rows if b["corpus"] == row["corpus"] and b["solver"] == row["solver"] and b["ranks"] == "1"]
+        p = int(row["ranks"])
+        row["strong_efficiency"] = "%.3f" % (float(base[0]["total_s"]) / (p*float(row["total_s"]))) if base and float(row["total_s"]) > 0 else ""
+    # weak scaling efficiency: throughput on p ranks over p times the throughput on one rank
+    for w in weak:
+        base = [b for b in weak if b["ranks"] == 1]
+        w["weak_efficiency"] = round(w["puzzles_per_sec"] / (w["ranks"]*base[0]["puzzles_per_sec"]), 3) if base else None
+
+    with open(args.out + ".csv", "w") as f:
+        writer = csv.DictWriter(f, fieldnames=list(rows[0].keys()) if rows else ["corpus"])
+        writer.writeheader()
+        writer.writerows(rows)
+    with open(args.out + ".json", "w") as f:
+        json.dump({"strong": rows, "weak": weak}, f, indent=2)
+
+    for row in rows:
+        print("%-14s %-20s %2s ranks: median %ss, p99 %ss, %s puzzles/sec, %s nodes/sec, strong efficiency %s" % (row["corpus"], row["solver"],
+            row["ranks"], row["median_s"], row["p99_s"], row["puzzles_per_sec"], row["nodes_per_sec"], row["strong_efficiency"] or "-"))
+    for w in weak:
+        print("batch %2d ranks: %.1f puzzles/sec, weak efficiency %s" % (w["ranks"], w["puzzles_per_sec"], w["weak_efficiency"]))
+    print("results written to %s.csv and %s.json" % (args.out, args.out))
+
+
+if __name__ == "__main__":
+    main()
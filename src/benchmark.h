@@ -0,0 +1,134 @@
+// solver benchmark: run each solver over a fixed corpus at the current rank count, and append one CSV row of latency, throughput
+// and node rate statistics per solver to a results file. bench.py runs this across corpora and rank counts and derives scaling
+// efficiency from the rows.
+
+/**
+ * compare two doubles for qsort
+ * @param a: the first double
+ * @param b: the second double
+ * @returns: negative, zero or positive as a is less than, equal to or greater than b
+ */
+int benchCompareDoubles(const void* a, const void* b) {
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * get a percentile of a sorted array using the nearest rank method
+ * @param sorted: the values, in ascending order
+ * @param n: the number of values
+ * @param percentile: the percentile to get (0-100)
+ * @returns: the smallest value at or above the requested fraction of values
+ */
+double benchPercentile(double* sorted, int n, double percentile) {
+	int index = ceil(percentile/100.0 * n) - 1;
+	return sorted[index < 0 ? 0 : index];
+}
+
+/**
+ * determine whether a solved board keeps every given of the puzzle it was solved from, and obeys all sudoku rules
+ * @param iBoard: 2d array containing the solved board data
+ * @param givens: the puzzle's cell values, one byte per cell
+ * @returns: whether the board is a valid solution of the puzzle (true) or not (false)
+ */
+bool benchSolutionIsValid(int** iBoard, unsigned char* givens) {
+	for (int i = 0; i < boardSize*boardSize; ++i)
+		if (givens[i] != 0 && iBoard[i/boardSize][i%boardSize] != givens[i]) return false;
+	return boardIsSolved(iBoard);
+}
+
+/**
+ * benchmark the selected solvers over every puzzle in a corpus; all ranks must call this together. solvers that run on one rank
+ * alone are skipped when there is more than one rank, as every rank would just repeat the same work.
+ * @param corpusName: the name of the corpus file, in either puzzle format
+ * @param solverNames: comma separated names of the solvers to run, or NULL to run them all
+ * @param outName: the name of the CSV file to append results to; a header row is written first if the file is empty
+ */
+void benchmarkCorpus(char corpusName[], char solverNames[], char outName[]) {
+	int numCells = boardSize*boardSize;
+	// rank 0 loads the whole corpus up front, so file parsing stays out of the timings
+	int numPuzzles = 0, capacity = 64;
+	unsigned char* corpus = NULL;
+	if (rank == 0) {
+		puzzleReader reader;
+		if (!puzzleReaderOpen(&reader, corpusName))
+			MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+		corpus = malloc(capacity*numCells);
+		while (puzzleReaderNext(&reader, &corpus[numPuzzles*numCells])) {
+			if (++numPuzzles == capacity)
+				corpus = realloc(corpus, (capacity *= 2)*numCells);
+		}
+		puzzleReaderClose(&reader);
+	}
+	MPI_Bcast(&numPuzzles, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	if (rank != 0)
+		corpus = malloc(numPuzzles*numCells);
+	MPI_Bcast(corpus, numPuzzles*numCells, MPI_UNSIGNED_CHAR, 0, MPI_COMM_WORLD);
+
+	FILE* out = NULL;
+	if (rank == 0) {
+		if ((out = fopen(outName, "a")) == NULL) {
+			fprintf(stderr,"Unable to open file %s for writing\n",outName);
+			MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+		}
+		fseek(out, 0, SEEK_END);
+		if (ftell(out) == 0)
+			fputs("corpus,solver,ranks,threads,puzzles,solved,min_s,median_s,p99_s,total_s,puzzles_per_sec,nodes,nodes_per_sec\n", out);
+	}
+
+	double* latencies = malloc(numPuzzles*sizeof(double));
+	for (int s = 0; s < numSolverEngines; ++s) {
+		solverEngine* solver = &solverEngines[s];
+		if (solverNames != NULL) {
+			// match whole names only within the comma separated list
+			char* found = strstr(solverNames, solver->name);
+			int len = strlen(solver->name);
+			if (found == NULL || (found != solverNames && found[-1] != ',') || (found[len] != '\0' && found[len] != ','))
+				continue;
+		}
+		if (!solver->collective && numRanks > 1)
+			continue;
+
+		resetExploredSet();
+		memset(portfolioWins, 0, sizeof(portfolioWins));
+		long long startNodes = totalNodes;
+		int numSolved = 0;
+		for (int p = 0; p < numPuzzles; ++p) {
+			unsigned char* givens = &corpus[p*numCells];
+			for (int i = 0; i < numCells; ++i)
+				board[i/boardSize][i%boardSize] = givens[i];
+			MPI_Barrier(MPI_COMM_WORLD);
+			double startTime = MPI_Wtime();
+			bool solved = solver->solve(board);
+			double elapsed = MPI_Wtime() - startTime;
+			// a collective solve takes as long as its slowest rank, and succeeds if any rank found a valid solution
+			int valid = solved && benchSolutionIsValid(board, givens), anyValid;
+			MPI_Allreduce(&elapsed, &latencies[p], 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+			MPI_Allreduce(&valid, &anyValid, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+			numSolved += anyValid;
+		}
+		long long rankNodes = totalNodes - startNodes, nodes;
+		MPI_Reduce(&rankNodes, &nodes, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+		if (rank == 0) {
+			double totalTime = 0;
+			for (int p = 0; p < numPuzzles; ++p)
+				totalTime += latencies[p];
+			qsort(latencies, numPuzzles, sizeof(double), benchCompareDoubles);
+			int threads = strcmp(solver->name, "hybridCP") == 0 ? hybridThreads : 1;
+			char* corpusBase = strrchr(corpusName, '/') != NULL ? strrchr(corpusName, '/') + 1 : corpusName;
+			fprintf(out, "%s,%s,%d,%d,%d,%d,%.9f,%.9f,%.9f,%.9f,%.3f,%lld,%.1f\n", corpusBase, solver->name, numRanks, threads, numPuzzles,
+				numSolved, numPuzzles > 0 ? latencies[0] : 0, numPuzzles > 0 ? benchPercentile(latencies, numPuzzles, 50) : 0,
+				numPuzzles > 0 ? benchPercentile(latencies, numPuzzles, 99) : 0, totalTime, numPuzzles / totalTime, nodes, nodes / totalTime);
+			fflush(out);
+			printf("%s %s: %d/%d solved, %fs total on %d ranks\n", corpusBase, solver->name, numSolved, numPuzzles, totalTime, numRanks);
+			fflush(stdout);
+		}
+		if (solver->solve == portfolioSolver)
+			reportPortfolioWins();
+	}
+	if (rank == 0)
+		fclose(out);
+	free(latencies);
+	free(corpus);
+}
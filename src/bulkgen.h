@@ -0,0 +1,80 @@
+// external references to functions defined in the generator
+void generateBoard(bool verbose);
+void generateUniqueBoard(MPI_Comm comm, int targetClues, long long targetDifficulty, bool verbose);
+
+#define BULK_BLOCK_PUZZLES 4096  // puzzles each rank buffers between collective writes
+
+/**
+ * generate puzzles on every rank at once, each rank drawing from its own random stream, and write them to a shared puzzle file.
+ * ranks buffer a block of puzzles at a time, then all ranks write their blocks side by side with a single collective write.
+ * rank 0 reports puzzles/sec across all ranks.
+ * @param numPuzzles: the total number of puzzles to generate, split evenly across ranks
+ * @param outName: the name of the file to write the puzzles to
+ * @param format: the puzzle format to write (PUZZLE_FORMAT_TEXT or PUZZLE_FORMAT_BINARY)
+ * @param unique: whether each puzzle must have a unique solution (true) or simply has removePercent of its cells removed (false)
+ * @param targetClues: with unique, stop removing cells at this many clues (0 removes as many as possible)
+ * @param targetDifficulty: with unique, stop removing cells once checking uniqueness takes this many search nodes (0 for no target)
+ */
+void bulkGenerate(long long numPuzzles, char outName[], int format, bool unique, int targetClues, long long targetDifficulty) {
+	int numCells = boardSize*boardSize;
+	int recordBytes = puzzleRecordBytes(format);
+	long long rankPuzzles = numPuzzles/numRanks + (rank < numPuzzles%numRanks);
+	long long maxRankPuzzles = numPuzzles/numRanks + (numPuzzles%numRanks != 0);
+	long long numBlocks = (maxRankPuzzles + BULK_BLOCK_PUZZLES-1) / BULK_BLOCK_PUZZLES;
+	unsigned char* buffer = malloc((size_t)BULK_BLOCK_PUZZLES*recordBytes);
+	unsigned char cells[numCells];
+
+	MPI_File fh;
+	if (MPI_File_open(MPI_COMM_WORLD, outName, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+		if (rank == 0) fprintf(stderr,"Unable to open file %s for writing\n",outName);
+		MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+	}
+	MPI_File_set_size(fh, 0);
+	MPI_Offset fileOffset = 0;
+	if (format == PUZZLE_FORMAT_BINARY) {
+		puzzleBinaryHeader header = puzzleMakeHeader(numPuzzles);
+		if (rank == 0)
+			MPI_File_write_at(fh, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+		fileOffset = sizeof(header);
+	}
+
+	MPI_Barrier(MPI_COMM_WORLD);
+	double startTime = MPI_Wtime(), writeTime = 0;
+	long long generated = 0;
+	for (long long b = 0; b < numBlocks; ++b) {
+		// fill our buffer with the next block of puzzles (ranks with a smaller share may have none left)
+		int blockPuzzles = rankPuzzles - generated < BULK_BLOCK_PUZZLES ? rankPuzzles - generated : BULK_BLOCK_PUZZLES;
+		unsigned char* record = buffer;
+		for (int p = 0; p < blockPuzzles; ++p) {
+			if (unique)
+				generateUniqueBoard(MPI_COMM_SELF, targetClues, targetDifficulty, false);
+			else
+				generateBoard(false);
+			for (int i = 0; i < numCells; ++i)
+				cells[i] = board[i/boardSize][i%boardSize];
+			puzzleEncode(format, cells, record);
+			record += recordBytes;
+		}
+		generated += blockPuzzles;
+
+		// each rank's block goes after the blocks of the ranks below it
+		double writeStart = MPI_Wtime();
+		long long blockBytes = (long long)blockPuzzles*recordBytes, bytesBefore = 0, bytesTotal;
+		MPI_Exscan(&blockBytes, &bytesBefore, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+		if (rank == 0)
+			bytesBefore = 0;
+		MPI_Allreduce(&blockBytes, &bytesTotal, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+		MPI_File_write_at_all(fh, fileOffset + bytesBefore, buffer, blockBytes, MPI_BYTE, MPI_STATUS_IGNORE);
+		fileOffset += bytesTotal;
+		writeTime += MPI_Wtime() - writeStart;
+	}
+	MPI_File_close(&fh);
+	double elapsed = MPI_Wtime() - startTime;
+
+	double maxWriteTime;
+	MPI_Reduce(&writeTime, &maxWriteTime, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+	if (rank == 0)
+		printf("Generated %lld %spuzzles in %fs (%.1f puzzles/sec across %d ranks, at most %fs per rank spent writing)\n",
+			numPuzzles, unique ? "unique " : "", elapsed, numPuzzles / elapsed, numRanks, maxWriteTime);
+	free(buffer);
+}
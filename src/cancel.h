@@ -0,0 +1,115 @@
+// cooperative cancellation for searches that run independently on every rank: the first rank to find a solution claims victory and
+// raises a one-sided flag in every rank's window, and the others notice it at their next poll and unwind their searches cleanly,
+// so that every rank can be timed and report its stats, and the job can go on to further work.
+// (the work-stealing and hybrid solvers already end cooperatively through their own schedulers, and need no polling.)
+
+#define CANCEL_POLL_INTERVAL 64  // search nodes between polls of our cancellation flag
+
+// window layout: each rank holds a cancel flag; rank 0's window also holds the winner slot, which records the winning rank+1,
+// and shared counters that searches may use while the window is open
+#define CANCEL_SLOT_FLAG 0
+#define CANCEL_SLOT_WINNER 1
+#define CANCEL_SLOT_COUNTER 2  // e.g. solutions found so far across all ranks
+#define CANCEL_SLOT_NEXT_TASK 3  // e.g. index of the next unclaimed subproblem
+#define CANCEL_NUM_SLOTS 4
+
+// slots are ints because Open MPI 4.1's shared-memory emulation of 64-bit compare-and-swap crashes
+MPI_Win cancelWin;
+int* cancelSlots;
+bool cancelActive = false;  // a cancellable search is under way with more than one rank
+bool cancelSeen;  // we have observed the cancel flag during the current search
+int cancelPollCountdown;
+
+// cancellation counters for this rank
+long long cancelPolls = 0;
+
+/**
+ * start a cancellable search: every rank must call this before searching. outside of a cancellable search
+ * (e.g. in the batch solver, where each rank solves its own puzzles) cancelRequested always reports false.
+ */
+void cancelInit() {
+	MPI_Win_allocate(CANCEL_NUM_SLOTS*sizeof(int), sizeof(int), MPI_INFO_NULL, MPI_COMM_WORLD, &cancelSlots, &cancelWin);
+	for (int i = 0; i < CANCEL_NUM_SLOTS; ++i)
+		cancelSlots[i] = 0;
+	MPI_Win_lock_all(MPI_MODE_NOCHECK, cancelWin);
+	MPI_Barrier(MPI_COMM_WORLD);
+	cancelActive = numRanks > 1;
+	cancelSeen = false;
+	cancelPollCountdown = CANCEL_POLL_INTERVAL;
+}
+
+/**
+ * check whether another rank has found a solution. cheap enough to call at every search node: the flag is only read once every
+ * CANCEL_POLL_INTERVAL calls, and once seen, the answer sticks so that the whole search stack unwinds at once.
+ * @returns: whether the current search should stop (true) or carry on (false)
+ */
+static inline bool cancelRequested() {
+	if (!cancelActive)
+		return false;
+	if (cancelSeen)
+		return true;
+	if (--cancelPollCountdown > 0)
+		return false;
+	cancelPollCountdown = CANCEL_POLL_INTERVAL;
+	++cancelPolls;
+	// read our own flag through the window (rather than straight from memory) so the MPI library makes progress on incoming puts
+	int flag;
+	MPI_Fetch_and_op(NULL, &flag, MPI_INT, rank, CANCEL_SLOT_FLAG, MPI_NO_OP, cancelWin);
+	MPI_Win_flush(rank, cancelWin);
+	cancelSeen = flag != 0;
+	return cancelSeen;
+}
+
+/**
+ * announce that we have found a solution. if several ranks finish at once, the first to claim rank 0's winner slot wins, and only
+ * the winner raises every rank's cancel flag.
+ * @returns: whether we are the winning rank (true) or another rank got there first (false)
+ */
+bool cancelAnnounce() {
+	int none = 0, claim = rank+1, previous;
+	MPI_Compare_and_swap(&claim, &none, &previous, MPI_INT, 0, CANCEL_SLOT_WINNER, cancelWin);
+	MPI_Win_flush(0, cancelWin);
+	STAT_SENT(sizeof(int));
+	if (previous != 0)
+		return false;
+	int raised = 1;
+	for (int i = 0; i < numRanks; ++i) {
+		if (i != rank) {
+			MPI_Accumulate(&raised, 1, MPI_INT, i, CANCEL_SLOT_FLAG, 1, MPI_INT, MPI_REPLACE, cancelWin);
+			STAT_SENT(sizeof(int));
+		}
+	}
+	MPI_Win_flush_all(cancelWin);
+	return true;
+}
+
+/**
+ * atomically add to one of rank 0's shared counters
+ * @param slot: the counter to add to (CANCEL_SLOT_COUNTER or CANCEL_SLOT_NEXT_TASK)
+ * @param value: the amount to add
+ * @returns: the counter's value before the addition
+ */
+int cancelFetchAdd(int slot, int value) {
+	int previous;
+	MPI_Fetch_and_op(&value, &previous, MPI_INT, 0, slot, MPI_SUM, cancelWin);
+	MPI_Win_flush(0, cancelWin);
+	STAT_SENT(sizeof(int));
+	return previous;
+}
+
+/**
+ * end a cancellable search: every rank must call this once its search has returned, whether it found a solution, was cancelled,
+ * or ran out of work.
+ * @returns: the winning rank, or -1 if no rank found a solution
+ */
+int cancelFinish() {
+	cancelActive = false;
+	cancelSeen = false;
+	MPI_Barrier(MPI_COMM_WORLD);
+	int winner;
+	MPI_Fetch_and_op(NULL, &winner, MPI_INT, 0, CANCEL_SLOT_WINNER, MPI_NO_OP, cancelWin);
+	MPI_Win_flush(0, cancelWin);
+	MPI_Win_unlock_all(cancelWin);
+	MPI_Win_free(&cancelWin);
+	return winner-1;
+}
@@ -0,0 +1,188 @@
+// solution counting on the CP engine, for checking that a puzzle has exactly one solution or enumerating every solution.
+// in parallel, every rank expands the same breadth-first frontier of subproblems, then ranks claim subproblems one at a time from
+// a shared counter; per-rank counts are merged with a reduction, and the search stops everywhere once the limit is reached.
+
+#define COUNT_TASKS_PER_RANK 32  // frontier subproblems to generate per rank, so that uneven subtrees even out across ranks
+
+bool countLimitReached;  // this rank has seen the solution count reach its limit
+long long countLimit;  // the number of solutions to stop at, or 0 to count every solution
+bool countShared;  // solutions are being counted by every rank together, through rank 0's shared counter
+
+/**
+ * record a solution found by this rank, checking whether the count has reached its limit across all ranks
+ * @param localCount: this rank's solution count, incremented in place
+ */
+void countRecordSolution(long long* localCount) {
+	++*localCount;
+	if (countLimit <= 0)
+		return;
+	long long globalCount = countShared ? cancelFetchAdd(CANCEL_SLOT_COUNTER, 1) + 1 : *localCount;
+	if (globalCount >= countLimit) {
+		countLimitReached = true;
+		// the rank that reaches the limit first tells the rest to stop
+		if (countShared)
+			cancelAnnounce();
+	}
+}
+
+/**
+ * core recursive internal function for CP solution counting; like the serial CP solver, but every branch is explored
+ * @param engine: the propagation engine holding the full possibleValues array, with the cells changed by the last decision queued
+ * @param localCount: this rank's solution count, incremented for each solution found
+ */
+void countCPSolutionsInternal(cpEngine* engine, long long* localCount) {
+	candidateSet* possibleValues = engine->possibleValues;
+	++engine->nodes;
+	if (countLimitReached || cancelRequested())
+		return;
+	if (!cpPropagate(engine))
+		return;
+
+	// propagation removes every singleton's value from its peers without emptying any cell, so an all-singleton state is a solution
+	if (!possibilitiesRemain(possibleValues)) {
+		countRecordSolution(localCount);
+		return;
+	}
+
+	int fewestCell = fewestPossibilitiesCell(possibleValues);
+	int trailMark = engine->trailLen;
+	STAT_ADD(engine->stats, depth, 1);
+	STAT_MAX(engine->stats, maxDepth, engine->stats.depth);
+	for (candidateSet remaining = possibleValues[fewestCell]; remaining != 0; remaining &= remaining-1) {
+		cpSetCandidates(engine, fewestCell, remaining & -remaining);
+		cpEnqueueCell(engine, fewestCell);
+		countCPSolutionsInternal(engine, localCount);
+		cpUndo(engine, trailMark);
+		STAT_ADD(engine->stats, backtracks, 1);
+		if (countLimitReached || cancelSeen)
+			break;
+	}
+	STAT_ADD(engine->stats, depth, -1);
+}
+
+/**
+ * expand the search tree breadth-first from the starting board until it holds enough open subproblems to share out.
+ * the expansion is deterministic, so every rank builds the same frontier without communicating.
+ * @param engine: a propagation engine loaded with the starting board
+ * @param target: the number of subproblems to stop at
+ * @param numTasks: filled with the number of subproblems returned
+ * @returns: the subproblems, numCells candidate sets each, which between them cover every solution of the starting board exactly once
+ */
+candidateSet* countBuildFrontier(cpEngine* engine, int target, int* numTasks) {
+	int numCells = engine->numCells;
+	size_t stateBytes = numCells*sizeof(candidateSet);
+	int capacity = target + boardSize;
+	candidateSet* open = malloc(capacity*stateBytes);
+	candidateSet* leaves = malloc(capacity*stateBytes);
+	int head = 0, tail = 1, numLeaves = 0;
+	memcpy(open, engine->possibleValues, stateBytes);
+
+	while (head < tail && (tail - head) + numLeaves < target) {
+		cpLoadState(engine, &open[(size_t)head*numCells]);
+		++head;
+		if (!cpPropagate(engine))
+			continue;
+		if (!possibilitiesRemain(engine->possibleValues)) {
+			memcpy(&leaves[(size_t)numLeaves++*numCells], engine->possibleValues, stateBytes);
+			continue;
+		}
+		// replace the subproblem with one child per value of its most constrained cell
+		int fewestCell = fewestPossibilitiesCell(engine->possibleValues);
+		candidateSet cands = engine->possibleValues[fewestCell];
+		if (tail + candCount(cands) > capacity) {
+			// slide the open subproblems back to the front before growing the buffers
+			memmove(open, &open[(size_t)head*numCells], (tail - head)*stateBytes);
+			tail -= head;
+			head = 0;
+			capacity = 2*capacity + boardSize;
+			open = realloc(open, capacity*stateBytes);
+			leaves = realloc(leaves, capacity*stateBytes);
+		}
+		for (candidateSet remaining = cands; remaining != 0; remaining &= remaining-1) {
+			candidateSet* child = &open[(size_t)tail++*numCells];
+			memcpy(child, engine->possibleValues, stateBytes);
+			child[fewestCell] = remaining & -remaining;
+		}
+	}
+
+	// the frontier is every subproblem left open plus every solution found on the way
+	memmove(open, &open[(size_t)head*numCells], (tail - head)*stateBytes);
+	memcpy(&open[(size_t)(tail - head)*numCells], leaves, (size_t)numLeaves*stateBytes);
+	*numTasks = (tail - head) + numLeaves;
+	free(leaves);
+	return open;
+}
+
+/**
+ * count the solutions of the specified board using every rank; all ranks must call this together.
+ * @param iBoard: 2d array containing the board data
+ * @param limit: the number of solutions to stop counting at (e.g. 2 to check uniqueness), or 0 to count every solution
+ * @returns: the number of solutions across all ranks, capped at limit when one is given
+ */
+long long parallelCPCountSolutions(int** iBoard, long long limit) {
+	cpEngine engine;
+	cpEngineInit(&engine, iBoard);
+	// the shared solution counter is an int
+	countLimit = limit < INT_MAX ? limit : INT_MAX;
+	countLimitReached = false;
+	countShared = numRanks > 1;
+	int numTasks;
+	STAT_TIMER_START(frontierStart);
+	candidateSet* tasks = countBuildFrontier(&engine, COUNT_TASKS_PER_RANK*numRanks, &numTasks);
+	STAT_TIMER_ADD(engine.stats, busyTime, frontierStart);
+
+	// claim subproblems until they run out or the limit is reached
+	long long localCount = 0;
+	if (numRanks > 1)
+		cancelInit();
+	for (int i = 0; !countLimitReached && !cancelRequested(); ++i) {
+		int task = numRanks > 1 ? cancelFetchAdd(CANCEL_SLOT_NEXT_TASK, 1) : i;
+		if (task >= numTasks)
+			break;
+		cpLoadState(&engine, &tasks[(size_t)task*engine.numCells]);
+		STAT_TIMER_START(startTime);
+		countCPSolutionsInternal(&engine, &localCount);
+		STAT_TIMER_ADD(engine.stats, busyTime, startTime);
+	}
+	if (numRanks > 1)
+		cancelFinish();
+	countShared = false;
+
+	long long totalCount = localCount;
+	if (numRanks > 1)
+		MPI_Allreduce(&localCount, &totalCount, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+	free(tasks);
+	cpEngineFree(&engine);
+	return limit > 0 && totalCount > limit ? limit : totalCount;
+}
+
+/**
+ * count the solutions of the specified board on this rank alone, such as while each rank checks a different puzzle
+ * @param iBoard: 2d array containing the board data
+ * @param limit: the number of solutions to stop counting at, or 0 to count every solution
+ * @param nodes: filled with the number of search nodes the count took, as a measure of the board's difficulty
+ * @returns: the number of solutions, capped at limit when one is given
+ */
+long long serialCPCountSolutions(int** iBoard, long long limit, long long* nodes) {
+	cpEngine engine;
+	cpEngineInit(&engine, iBoard);
+	countLimit = limit;
+	countLimitReached = false;
+	long long count = 0;
+	STAT_TIMER_START(startTime);
+	countCPSolutionsInternal(&engine, &count);
+	STAT_TIMER_ADD(engine.stats, busyTime, startTime);
+	*nodes = engine.nodes;
+	cpEngineFree(&engine);
+	return count;
+}
+
+/**
+ * check whether the specified board has exactly one solution on this rank alone, stopping as soon as a second one turns up
+ * @param iBoard: 2d array containing the board data
+ * @param nodes: filled with the number of search nodes the check took, as a measure of the board's difficulty
+ * @returns: whether the board has a unique solution (true) or has none or several (false)
+ */
+bool boardHasUniqueSolution(int** iBoard, long long* nodes) {
+	return serialCPCountSolutions(iBoard, 2, nodes) == 1;
+}
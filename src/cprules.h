@@ -0,0 +1,298 @@
+// advanced propagation rules for the CP engine, enabled by raising cpLevel. they run only once the basic rules (peer elimination
+// and hidden singles) have reached their fixpoint, one unit at a time from a queue of units whose cells changed since the rules
+// last looked at them; every rule only removes candidates, so propagation still reaches the same fixpoint whatever the order.
+// each rule's successful applications are counted per engine and added to this rank's totals when the engine is freed.
+
+/**
+ * remove values from a cell's candidates, queueing the cell if anything changed
+ * @param engine: the propagation engine
+ * @param cell: the index of the cell to change
+ * @param values: the values to remove
+ * @returns: whether any candidates were removed (true) or the cell held none of the values (false)
+ */
+static inline bool cpEliminate(cpEngine* engine, int cell, candidateSet values) {
+	candidateSet cands = engine->possibleValues[cell];
+	if ((cands & values) == 0)
+		return false;
+	cpSetCandidates(engine, cell, cands & ~values);
+	cpEnqueueCell(engine, cell);
+	return true;
+}
+
+/**
+ * apply the intersection rules to a unit. in a region, a value confined to one row (or column) of the region is removed from the
+ * rest of that row (pointing); in a row or column, a value confined to one region is removed from the rest of that region (box/line).
+ * @param n: the board size, a compile-time constant in each specialized copy
+ * @param k: the region size, a compile-time constant in each specialized copy
+ * @param engine: the propagation engine
+ * @param unit: the index of the unit to check (rows, then columns, then regions)
+ * @returns: whether any candidates were removed (true) or not (false)
+ */
+SIZED_KERNEL bool cpIntersectionsKernel(const int n, const int k, cpEngine* engine, int unit) {
+	candidateSet* possibleValues = engine->possibleValues;
+	uint16_t* unitCells = &units[unit*n];
+	bool changed = false;
+	if (unit >= 2*n) {
+		// pointing: OR together the candidates of each row and each column of the region
+		int region = unit - 2*n, regionRow = region/k*k, regionCol = region%k*k;
+		candidateSet rowCands[k], colCands[k];
+		for (int i = 0; i < k; ++i)
+			rowCands[i] = colCands[i] = 0;
+		for (int i = 0; i < n; ++i) {
+			rowCands[i/k] |= possibleValues[unitCells[i]];
+			colCands[i%k] |= possibleValues[unitCells[i]];
+		}
+		for (int i = 0; i < k; ++i) {
+			candidateSet otherRows = 0, otherCols = 0;
+			for (int j = 0; j < k; ++j) {
+				if (j == i) continue;
+				otherRows |= rowCands[j];
+				otherCols |= colCands[j];
+			}
+			candidateSet rowOnly = rowCands[i] & ~otherRows, colOnly = colCands[i] & ~otherCols;
+			bool hit = false;
+			for (int j = 0; j < n; ++j) {
+				if (rowOnly && j/k != region%k) hit |= cpEliminate(engine, (regionRow + i)*n + j, rowOnly);
+				if (colOnly && j/k != region/k) hit |= cpEliminate(engine, j*n + regionCol + i, colOnly);
+			}
+			engine->ruleHits[CP_RULE_POINTING] += hit;
+			changed |= hit;
+		}
+	}
+	else {
+		// box/line: OR together the candidates of the row or column's segment in each region it crosses
+		candidateSet segCands[k];
+		for (int i = 0; i < k; ++i)
+			segCands[i] = 0;
+		for (int i = 0; i < n; ++i)
+			segCands[i/k] |= possibleValues[unitCells[i]];
+		bool isRow = unit < n;
+		int line = isRow ? unit : unit - n;
+		for (int i = 0; i < k; ++i) {
+			candidateSet others = 0;
+			for (int j = 0; j < k; ++j)
+				if (j != i) others |= segCands[j];
+			candidateSet segOnly = segCands[i] & ~others;
+			if (segOnly == 0) continue;
+			int region = isRow ? line/k*k + i : i*k + line/k;
+			uint16_t* regionCells = &units[(2*n + region)*n];
+			bool hit = false;
+			for (int j = 0; j < n; ++j) {
+				int cell = regionCells[j];
+				if ((isRow ? cell/n : cell%n) != line)
+					hit |= cpEliminate(engine, cell, segOnly);
+			}
+			engine->ruleHits[CP_RULE_BOX_LINE] += hit;
+			changed |= hit;
+		}
+	}
+	engine->propagationVisits += n;
+	return changed;
+}
+
+/**
+ * apply the naked subset rules to a unit: when two cells hold the same two candidates, or three cells hold only three candidates
+ * between them, those values are removed from the unit's other cells
+ * @param n: the board size, a compile-time constant in each specialized copy
+ * @param engine: the propagation engine
+ * @param unit: the index of the unit to check
+ * @param contradiction: set to true if three cells share only two candidates between them
+ * @returns: whether any candidates were removed (true) or not (false)
+ */
+SIZED_KERNEL bool cpNakedSubsetsKernel(const int n, cpEngine* engine, int unit, bool* contradiction) {
+	candidateSet* possibleValues = engine->possibleValues;
+	uint16_t* unitCells = &units[unit*n];
+	// only unsolved cells with two or three candidates can belong to a pair or triple
+	int members[n], numMembers = 0;
+	for (int i = 0; i < n; ++i) {
+		int count = candCount(possibleValues[unitCells[i]]);
+		if (count == 2 || count == 3)
+			members[numMembers++] = i;
+	}
+	engine->propagationVisits += n;
+	for (int a = 0; a < numMembers; ++a) {
+		candidateSet candsA = possibleValues[unitCells[members[a]]];
+		for (int b = a+1; b < numMembers; ++b) {
+			candidateSet pair = candsA | possibleValues[unitCells[members[b]]];
+			int pairCount = candCount(pair);
+			if (pairCount == 2) {
+				bool hit = false;
+				for (int i = 0; i < n; ++i)
+					if (i != members[a] && i != members[b])
+						hit |= cpEliminate(engine, unitCells[i], pair);
+				engine->ruleHits[CP_RULE_NAKED_PAIR] += hit;
+				if (hit) return true;
+				continue;
+			}
+			if (pairCount > 3)
+				continue;
+			for (int c = b+1; c < numMembers; ++c) {
+				candidateSet triple = pair | possibleValues[unitCells[members[c]]];
+				int tripleCount = candCount(triple);
+				if (tripleCount < 3) {
+					*contradiction = true;
+					return false;
+				}
+				if (tripleCount > 3)
+					continue;
+				bool hit = false;
+				for (int i = 0; i < n; ++i)
+					if (i != members[a] && i != members[b] && i != members[c])
+						hit |= cpEliminate(engine, unitCells[i], triple);
+				engine->ruleHits[CP_RULE_NAKED_TRIPLE] += hit;
+				if (hit) return true;
+			}
+		}
+	}
+	return false;
+}
+
+/**
+ * apply the hidden subset rules to a unit: when two values can only go in the same two cells, or three values can only go in three
+ * cells between them, every other value is removed from those cells
+ * @param n: the board size, a compile-time constant in each specialized copy
+ * @param engine: the propagation engine
+ * @param unit: the index of the unit to check
+ * @param contradiction: set to true if three values can only go in two cells between them
+ * @returns: whether any candidates were removed (true) or not (false)
+ */
+SIZED_KERNEL bool cpHiddenSubsetsKernel(const int n, cpEngine* engine, int unit, bool* contradiction) {
+	candidateSet* possibleValues = engine->possibleValues;
+	uint16_t* unitCells = &units[unit*n];
+	// transpose the unit's candidates: for each value, the set of positions in the unit where it can go
+	uint64_t positions[n];
+	for (int v = 0; v < n; ++v)
+		positions[v] = 0;
+	for (int i = 0; i < n; ++i)
+		for (candidateSet cands = possibleValues[unitCells[i]]; cands != 0; cands &= cands-1)
+			positions[__builtin_ctzll(cands)] |= (uint64_t)1 << i;
+	engine->propagationVisits += n;
+
+	// only values with two or three possible positions can belong to a hidden pair or triple
+	int members[n], numMembers = 0;
+	for (int v = 0; v < n; ++v) {
+		int count = __builtin_popcountll(positions[v]);
+		if (count == 2 || count == 3)
+			members[numMembers++] = v;
+	}
+	for (int a = 0; a < numMembers; ++a) {
+		for (int b = a+1; b < numMembers; ++b) {
+			uint64_t pair = positions[members[a]] | positions[members[b]];
+			int pairCount = __builtin_popcountll(pair);
+			if (pairCount == 2) {
+				candidateSet keep = candBit(members[a]+1) | candBit(members[b]+1);
+				bool hit = false;
+				for (uint64_t cells = pair; cells != 0; cells &= cells-1)
+					hit |= cpEliminate(engine, unitCells[__builtin_ctzll(cells)], ~keep);
+				engine->ruleHits[CP_RULE_HIDDEN_PAIR] += hit;
+				if (hit) return true;
+				continue;
+			}
+			if (pairCount > 3)
+				continue;
+			for (int c = b+1; c < numMembers; ++c) {
+				uint64_t triple = pair | positions[members[c]];
+				int tripleCount = __builtin_popcountll(triple);
+				if (tripleCount < 3) {
+					*contradiction = true;
+					return false;
+				}
+				if (tripleCount > 3)
+					continue;
+				candidateSet keep = candBit(members[a]+1) | candBit(members[b]+1) | candBit(members[c]+1);
+				bool hit = false;
+				for (uint64_t cells = triple; cells != 0; cells &= cells-1)
+					hit |= cpEliminate(engine, unitCells[__builtin_ctzll(cells)], ~keep);
+				engine->ruleHits[CP_RULE_HIDDEN_TRIPLE] += hit;
+				if (hit) return true;
+			}
+		}
+	}
+	return false;
+}
+
+/**
+ * get the positions along a row or column where a value can go
+ * @param n: the board size, a compile-time constant in each specialized copy
+ * @param possibleValues: the full possibleValues array
+ * @param line: the index of the row or column unit
+ * @param value: the value's candidate set bit
+ * @returns: a bitmask with bit i set if the value is possible at the line's i'th cell
+ */
+SIZED_KERNEL uint64_t cpLinePositionsKernel(const int n, candidateSet* possibleValues, int line, candidateSet value) {
+	uint16_t* lineCells = &units[line*n];
+	uint64_t positions = 0;
+	for (int i = 0; i < n; ++i)
+		if (possibleValues[lineCells[i]] & value)
+			positions |= (uint64_t)1 << i;
+	return positions;
+}
+
+/**
+ * apply the X-wing rule to a row or column: when a value can only go in the same two positions along two parallel lines, it must
+ * take those positions in one of the two ways, so it is removed from the crossing lines everywhere else
+ * @param n: the board size, a compile-time constant in each specialized copy
+ * @param engine: the propagation engine
+ * @param unit: the index of the row or column unit to check
+ * @returns: whether any candidates were removed (true) or not (false)
+ */
+SIZED_KERNEL bool cpXWingKernel(const int n, cpEngine* engine, int unit) {
+	candidateSet* possibleValues = engine->possibleValues;
+	int firstLine = unit < n ? 0 : n;
+	for (int v = 1; v <= n; ++v) {
+		candidateSet value = candBit(v);
+		uint64_t positions = cpLinePositionsKernel(n, possibleValues, unit, value);
+		if (__builtin_popcountll(positions) != 2)
+			continue;
+		int posA = __builtin_ctzll(positions), posB = 63 - __builtin_clzll(positions);
+		engine->propagationVisits += (long long)n*n;
+		for (int other = firstLine; other < firstLine + n; ++other) {
+			if (other == unit || cpLinePositionsKernel(n, possibleValues, other, value) != positions)
+				continue;
+			bool hit = false;
+			for (int line = firstLine; line < firstLine + n; ++line) {
+				if (line == unit || line == other) continue;
+				hit |= cpEliminate(engine, units[line*n + posA], value);
+				hit |= cpEliminate(engine, units[line*n + posB], value);
+			}
+			engine->ruleHits[CP_RULE_X_WING] += hit;
+			if (hit) return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * apply every advanced rule enabled by cpLevel to a unit, cheapest first, stopping at the first rule that removes candidates
+ * so the basic rules can follow up on its changes before anything more expensive runs. the unit is then queued again, as the
+ * intersection and X-wing rules change cells outside it, and the rules it skipped must still get their turn.
+ * @param n: the board size, a compile-time constant in each specialized copy
+ * @param k: the region size, a compile-time constant in each specialized copy
+ * @param engine: the propagation engine
+ * @param unit: the index of the unit to check (rows, then columns, then regions)
+ * @returns: whether the unit is still consistent (true) or a contradiction was found (false)
+ */
+SIZED_KERNEL bool cpApplyRulesKernel(const int n, const int k, cpEngine* engine, int unit) {
+	if (cpIntersectionsKernel(n, k, engine, unit)) {
+		cpEnqueueRuleUnit(engine, unit);
+		return true;
+	}
+	if (cpLevel < CP_LEVEL_SUBSETS)
+		return true;
+	bool contradiction = false;
+	if (cpNakedSubsetsKernel(n, engine, unit, &contradiction) && !contradiction) {
+		cpEnqueueRuleUnit(engine, unit);
+		return true;
+	}
+	if (contradiction)
+		return false;
+	if (cpHiddenSubsetsKernel(n, engine, unit, &contradiction) && !contradiction) {
+		cpEnqueueRuleUnit(engine, unit);
+		return true;
+	}
+	if (contradiction)
+		return false;
+	if (cpLevel >= CP_LEVEL_FISH && unit < 2*n && cpXWingKernel(n, engine, unit))
+		cpEnqueueRuleUnit(engine, unit);
+	return true;
+}
@@ -0,0 +1,400 @@
+// exact cover solver: Knuth's Algorithm X with dancing links. sudoku is an exact cover problem over 4*n^2 constraint columns
+// (each cell holds a value, and each row, column and region holds each value), with one candidate row per (cell, value) pair that
+// covers one column of each kind. the search always branches on the column with the fewest rows left.
+// the matrix lives in a single pool of nodes that is reused from one solve to the next.
+// in parallel, every rank walks the same shallow part of the search tree, and the nodes at a split depth chosen to give about
+// DLX_TASKS_PER_RANK nodes per rank are shared out as tasks: claimed from rank 0's shared counter when a cancellable search has
+// its window open, or dealt out round robin otherwise.
+
+#define DLX_TASKS_PER_RANK 32
+
+// one node of the matrix: a column header (including the root header, node 0) or one entry of a candidate row
+typedef struct {
+	int left, right, up, down;
+	int column;  // the header node of this node's column
+	int row;  // the candidate row (cell*boardSize + value-1) this entry belongs to, or -1 for headers
+} dlxNode;
+
+// the exact cover matrix and search state
+typedef struct {
+	dlxNode* nodes;  // the root, then one header per column, then four entries per candidate row, all contiguous
+	int* size;  // number of rows left in each column, indexed by header node
+	int* solution;  // the entry node chosen at each depth of the current search path
+	int numColumns, numNodes;
+	int builtSize;  // board size the pool was allocated for
+	int splitDepth;  // depth at which search nodes become parallel tasks, or -1 for a serial search
+	int nextTask;  // number of task nodes walked past so far
+	int claimedTask;  // the next task this rank will search
+	bool claimShared;  // tasks are claimed through rank 0's shared counter (true) or dealt out round robin (false)
+	long long nodesVisited;
+} dlxMatrix;
+
+dlxMatrix dlx = {NULL};
+
+/**
+ * remove a column from the header list, and every row that covers it from the other columns it covers
+ * @param m: the matrix
+ * @param c: the column's header node
+ */
+static inline void dlxCover(dlxMatrix* m, int c) {
+	dlxNode* nodes = m->nodes;
+	nodes[nodes[c].right].left = nodes[c].left;
+	nodes[nodes[c].left].right = nodes[c].right;
+	for (int i = nodes[c].down; i != c; i = nodes[i].down) {
+		for (int j = nodes[i].right; j != i; j = nodes[j].right) {
+			nodes[nodes[j].down].up = nodes[j].up;
+			nodes[nodes[j].up].down = nodes[j].down;
+			--m->size[nodes[j].column];
+		}
+	}
+}
+
+/**
+ * undo dlxCover, restoring links in exactly the reverse order they were removed
+ * @param m: the matrix
+ * @param c: the column's header node
+ */
+static inline void dlxUncover(dlxMatrix* m, int c) {
+	dlxNode* nodes = m->nodes;
+	for (int i = nodes[c].up; i != c; i = nodes[i].up) {
+		for (int j = nodes[i].left; j != i; j = nodes[j].left) {
+			++m->size[nodes[j].column];
+			nodes[nodes[j].down].up = j;
+			nodes[nodes[j].up].down = j;
+		}
+	}
+	nodes[nodes[c].right].left = c;
+	nodes[nodes[c].left].right = c;
+}
+
+/**
+ * build the full exact cover matrix for the current board size in the pool, then cover the rows of the board's givens
+ * @param m: the matrix
+ * @param iBoard: 2d array containing the board data
+ * @returns: whether the givens are consistent (true) or some row, column or region repeats a value (false)
+ */
+bool dlxBuild(dlxMatrix* m, int** iBoard) {
+	placementMasks masks;
+	if (!placementMasksInit(&masks, iBoard))
+		return false;
+	int n = boardSize, numCells = n*n;
+	if (m->builtSize != n) {
+		m->numColumns = 4*numCells;
+		m->numNodes = 1 + m->numColumns + 4*numCells*n;
+		m->nodes = realloc(m->nodes, m->numNodes*sizeof(dlxNode));
+		m->size = realloc(m->size, (1 + m->numColumns)*sizeof(int));
+		m->solution = realloc(m->solution, numCells*sizeof(int));
+		m->builtSize = n;
+	}
+	dlxNode* nodes = m->nodes;
+
+	// the root and column headers form a ring; each header starts out as an empty vertical ring
+	for (int c = 0; c <= m->numColumns; ++c) {
+		nodes[c] = (dlxNode){c-1, c+1, c, c, c, -1};
+		m->size[c] = 0;
+	}
+	nodes[0].left = m->numColumns;
+	nodes[m->numColumns].right = 0;
+
+	// append each candidate row's four entries to the bottom of their columns, in row order
+	int next = 1 + m->numColumns;
+	for (int cell = 0; cell < numCells; ++cell) {
+		int row = cell/n, col = cell%n, region = regionOf(row, col);
+		for (int v = 0; v < n; ++v) {
+			int columns[4] = {1 + cell, 1 + numCells + row*n + v, 1 + 2*numCells + col*n + v, 1 + 3*numCells + region*n + v};
+			for (int j = 0; j < 4; ++j) {
+				int c = columns[j], node = next + j;
+				nodes[node] = (dlxNode){next + (j+3)%4, next + (j+1)%4, nodes[c].up, c, c, cell*n + v};
+				nodes[nodes[c].up].down = node;
+				nodes[c].up = node;
+				++m->size[c];
+			}
+			next += 4;
+		}
+	}
+
+	// the givens are already placed: cover every column their rows cover
+	for (int cell = 0; cell < numCells; ++cell) {
+		int val = iBoard[cell/n][cell%n];
+		if (val == 0) continue;
+		int entry = 1 + m->numColumns + 4*(cell*n + val-1);
+		for (int j = 0; j < 4; ++j)
+			dlxCover(m, nodes[entry + j].column);
+	}
+	return true;
+}
+
+/**
+ * find the uncovered column with the fewest rows left
+ * @param m: the matrix
+ * @returns: the column's header node (its size is 0 if the current branch is a dead end)
+ */
+static inline int dlxChooseColumn(dlxMatrix* m) {
+	dlxNode* nodes = m->nodes;
+	int best = nodes[0].right, bestSize = m->size[best];
+	for (int c = nodes[best].right; c != 0 && bestSize > 1; c = nodes[c].right) {
+		if (m->size[c] < bestSize) {
+			best = c;
+			bestSize = m->size[c];
+		}
+	}
+	return best;
+}
+
+/**
+ * in a parallel search, decide whether this rank searches the subtree below the current node. every rank walks the tree above the
+ * split depth in the same order, so the task nodes (those at the split depth, and solutions found above it) are numbered alike.
+ * @param m: the matrix
+ * @param depth: the current node's depth
+ * @param solved: whether the current node is a solution
+ * @returns: whether this rank should carry on from the node (true) or leave it to another rank (false)
+ */
+bool dlxClaimNode(dlxMatrix* m, int depth, bool solved) {
+	if (depth != m->splitDepth && !(solved && depth < m->splitDepth))
+		return true;
+	int task = m->nextTask++;
+	if (!m->claimShared)
+		return task % numRanks == rank;
+	if (task != m->claimedTask)
+		return false;
+	// claim our next task before searching this one, so that every task is claimed before any rank walks past it
+	m->claimedTask = cancelFetchAdd(CANCEL_SLOT_NEXT_TASK, 1);
+	return true;
+}
+
+/**
+ * core recursive internal function for the DLX solver
+ * @param m: the matrix
+ * @param depth: the number of rows chosen so far
+ * @returns: whether this branch led to a solution (true) or not (false)
+ */
+bool dlxSolveInternal(dlxMatrix* m, int depth) {
+	dlxNode* nodes = m->nodes;
+	++m->nodesVisited;
+	// stop early if another rank has already found a solution
+	if (cancelRequested())
+		return false;
+	bool solved = nodes[0].right == 0;
+	if (m->splitDepth >= 0 && !dlxClaimNode(m, depth, solved))
+		return false;
+	if (solved)
+		return true;
+	STAT_MAX(rankStats, maxDepth, depth+1);
+
+	int c = dlxChooseColumn(m);
+	if (m->size[c] == 0)
+		return false;
+	dlxCover(m, c);
+	for (int r = nodes[c].down; r != c; r = nodes[r].down) {
+		m->solution[depth] = r;
+		for (int j = nodes[r].right; j != r; j = nodes[j].right)
+			dlxCover(m, nodes[j].column);
+		if (dlxSolveInternal(m, depth+1))
+			return true;
+		for (int j = nodes[r].left; j != r; j = nodes[j].left)
+			dlxUncover(m, nodes[j].column);
+	}
+	dlxUncover(m, c);
+	STAT_ADD(rankStats, backtracks, 1);
+	return false;
+}
+
+/**
+ * core recursive internal function for DLX solution counting; like dlxSolveInternal, but every branch is explored
+ * @param m: the matrix
+ * @param depth: the number of rows chosen so far
+ * @param localCount: this rank's solution count, incremented for each solution found
+ */
+void dlxCountInternal(dlxMatrix* m, int depth, long long* localCount) {
+	dlxNode* nodes = m->nodes;
+	++m->nodesVisited;
+	if (countLimitReached || cancelRequested())
+		return;
+	bool solved = nodes[0].right == 0;
+	if (m->splitDepth >= 0 && !dlxClaimNode(m, depth, solved))
+		return;
+	if (solved) {
+		countRecordSolution(localCount);
+		return;
+	}
+
+	int c = dlxChooseColumn(m);
+	if (m->size[c] == 0)
+		return;
+	dlxCover(m, c);
+	for (int r = nodes[c].down; r != c; r = nodes[r].down) {
+		for (int j = nodes[r].right; j != r; j = nodes[j].right)
+			dlxCover(m, nodes[j].column);
+		dlxCountInternal(m, depth+1, localCount);
+		for (int j = nodes[r].left; j != r; j = nodes[j].left)
+			dlxUncover(m, nodes[j].column);
+		if (countLimitReached || cancelSeen)
+			break;
+	}
+	dlxUncover(m, c);
+}
+
+/**
+ * count the search nodes at a given depth, plus any solutions above it, without searching any deeper
+ * @param m: the matrix
+ * @param depth: the current node's depth
+ * @param targetDepth: the depth to count nodes at
+ * @returns: the number of nodes at targetDepth below the current node, plus the solutions above it
+ */
+long long dlxNodesAtDepth(dlxMatrix* m, int depth, int targetDepth) {
+	dlxNode* nodes = m->nodes;
+	if (depth == targetDepth || nodes[0].right == 0)
+		return 1;
+	int c = dlxChooseColumn(m);
+	long long count = 0;
+	dlxCover(m, c);
+	for (int r = nodes[c].down; r != c; r = nodes[r].down) {
+		for (int j = nodes[r].right; j != r; j = nodes[j].right)
+			dlxCover(m, nodes[j].column);
+		count += dlxNodesAtDepth(m, depth+1, targetDepth);
+		for (int j = nodes[r].left; j != r; j = nodes[j].left)
+			dlxUncover(m, nodes[j].column);
+	}
+	dlxUncover(m, c);
+	return count;
+}
+
+/**
+ * set up a search to be shared between ranks: choose the shallowest split depth with at least DLX_TASKS_PER_RANK nodes per rank
+ * (or the deepest depth the tree reaches, if it never has that many), and decide how tasks are handed out
+ * @param m: the matrix, built for the board being searched
+ * @param shared: whether tasks should be claimed through rank 0's shared counter, which needs a cancellable search's window
+ */
+void dlxSplitSearch(dlxMatrix* m, bool shared) {
+	m->splitDepth = 0;
+	for (int depth = 1; depth <= boardSize*boardSize; ++depth) {
+		long long count = dlxNodesAtDepth(m, 0, depth);
+		if (count == 0)
+			break;
+		m->splitDepth = depth;
+		if (count >= DLX_TASKS_PER_RANK*numRanks)
+			break;
+	}
+	m->nextTask = 0;
+	m->claimShared = shared;
+	if (shared)
+		m->claimedTask = cancelFetchAdd(CANCEL_SLOT_NEXT_TASK, 1);
+}
+
+/**
+ * fill in iBoard's empty cells from the rows on the solution path
+ * @param m: the matrix, holding a solved search path
+ * @param iBoard: 2d array containing the board data
+ * @param depth: the number of rows on the path
+ */
+void dlxCopySolution(dlxMatrix* m, int** iBoard, int depth) {
+	for (int d = 0; d < depth; ++d) {
+		int row = m->nodes[m->solution[d]].row;
+		iBoard[row/boardSize/boardSize][row/boardSize%boardSize] = row%boardSize + 1;
+	}
+}
+
+/**
+ * count the empty cells of a board, which is the depth of any solution's search path
+ * @param iBoard: 2d array containing the board data
+ * @returns: the number of cells holding 0
+ */
+int dlxEmptyCells(int** iBoard) {
+	int empty = 0;
+	for (int i = 0; i < boardSize*boardSize; ++i)
+		empty += iBoard[i/boardSize][i%boardSize] == 0;
+	return empty;
+}
+
+/**
+ * solve the specified board serially with dancing links
+ * @param iBoard: 2d array containing the board data
+ * @returns: whether a solution was found (true) or not, either because none exists or because another rank found one first (false)
+ */
+bool serialDLXSolver(int** iBoard) {
+	if (!dlxBuild(&dlx, iBoard))
+		return false;
+	dlx.splitDepth = -1;
+	dlx.nodesVisited = 0;
+	STAT_TIMER_START(startTime);
+	bool solved = dlxSolveInternal(&dlx, 0);
+	STAT_TIMER_ADD(rankStats, busyTime, startTime);
+	totalNodes += dlx.nodesVisited;
+	if (solved)
+		dlxCopySolution(&dlx, iBoard, dlxEmptyCells(iBoard));
+	return solved;
+}
+
+/**
+ * solve the specified board with dancing links, sharing the search tree between ranks; all ranks must call this together.
+ * inside a cancellable search, ranks claim subtrees from a shared counter and stop once any rank announces a solution.
+ * @param iBoard: 2d array containing the board data
+ * @returns: whether this rank found a solution (true) or not (false)
+ */
+bool parallelDLXSolver(int** iBoard) {
+	if (numRanks == 1)
+		return serialDLXSolver(iBoard);
+	if (!dlxBuild(&dlx, iBoard))
+		return false;
+	dlx.nodesVisited = 0;
+	STAT_TIMER_START(startTime);
+	dlxSplitSearch(&dlx, cancelActive);
+	bool solved = dlxSolveInternal(&dlx, 0);
+	STAT_TIMER_ADD(rankStats, busyTime, startTime);
+	totalNodes += dlx.nodesVisited;
+	if (solved)
+		dlxCopySolution(&dlx, iBoard, dlxEmptyCells(iBoard));
+	return solved;
+}
+
+/**
+ * count the solutions of the specified board with dancing links on this rank alone
+ * @param iBoard: 2d array containing the board data
+ * @param limit: the number of solutions to stop counting at, or 0 to count every solution
+ * @param nodes: filled with the number of search nodes the count took
+ * @returns: the number of solutions, capped at limit when one is given
+ */
+long long serialDLXCountSolutions(int** iBoard, long long limit, long long* nodes) {
+	long long count = 0;
+	dlx.nodesVisited = 0;
+	if (dlxBuild(&dlx, iBoard)) {
+		countLimit = limit;
+		countLimitReached = false;
+		dlx.splitDepth = -1;
+		dlxCountInternal(&dlx, 0, &count);
+	}
+	*nodes = dlx.nodesVisited;
+	totalNodes += dlx.nodesVisited;
+	return count;
+}
+
+/**
+ * count the solutions of the specified board with dancing links using every rank; all ranks must call this together.
+ * @param iBoard: 2d array containing the board data
+ * @param limit: the number of solutions to stop counting at (e.g. 2 to check uniqueness), or 0 to count every solution
+ * @returns: the number of solutions across all ranks, capped at limit when one is given
+ */
+long long parallelDLXCountSolutions(int** iBoard, long long limit) {
+	if (numRanks == 1) {
+		long long nodes;
+		return serialDLXCountSolutions(iBoard, limit, &nodes);
+	}
+	// the shared solution counter is an int
+	countLimit = limit < INT_MAX ? limit : INT_MAX;
+	countLimitReached = false;
+	countShared = true;
+	long long localCount = 0;
+	dlx.nodesVisited = 0;
+	cancelInit();
+	if (dlxBuild(&dlx, iBoard)) {
+		dlxSplitSearch(&dlx, true);
+		dlxCountInternal(&dlx, 0, &localCount);
+	}
+	cancelFinish();
+	countShared = false;
+	totalNodes += dlx.nodesVisited;
+
+	long long totalCount;
+	MPI_Allreduce(&localCount, &totalCount, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+	return limit > 0 && totalCount > limit ? limit : totalCount;
+}
@@ -0,0 +1,34 @@
+// registry of solver engines: every solver with the common signature, by name, so that the engine used to solve a board can be
+// chosen with --engine and the engines to benchmark with --solvers, without recompiling
+
+// a registered solver engine
+typedef struct {
+	const char* name;
+	bool (*solve)(int** iBoard);
+	bool collective;  // every rank must call the solver together (true), or it runs on one rank alone (false)
+	long long (*countSolutions)(int** iBoard, long long limit);  // solution counter used with --count; every rank calls it together
+} solverEngine;
+
+solverEngine solverEngines[] = {
+	{"serialBruteForce", serialBruteForceSolver, false, parallelCPCountSolutions},
+	{"parallelBruteForce", parallelBruteForceSolver, true, parallelCPCountSolutions},
+	{"serialMask", serialMaskSolver, false, parallelCPCountSolutions},
+	{"serialDLX", serialDLXSolver, false, parallelDLXCountSolutions},
+	{"parallelDLX", parallelDLXSolver, true, parallelDLXCountSolutions},
+	{"serialCP", serialCPSolver, false, parallelCPCountSolutions},
+	{"parallelCP", parallelCPSolver, true, parallelCPCountSolutions},
+	{"hybridCP", hybridCPSolver, true, parallelCPCountSolutions},
+	{"portfolio", portfolioSolver, true, parallelCPCountSolutions},
+};
+const int numSolverEngines = sizeof(solverEngines) / sizeof(solverEngine);
+
+/**
+ * look up a solver engine by name
+ * @param name: the engine's registered name
+ * @returns: the engine, or NULL if no engine has that name
+ */
+solverEngine* findSolverEngine(const char* name) {
+	for (int i = 0; i < numSolverEngines; ++i)
+		if (strcmp(solverEngines[i].name, name) == 0) return &solverEngines[i];
+	return NULL;
+}
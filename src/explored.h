@@ -0,0 +1,109 @@
+// bounded hash set of explored search states whose subtrees held no solution, keyed by an incrementally maintained Zobrist hash.
+// the key covers the cells that are singletons after propagation; because propagation always runs to the same fixpoint, two nodes
+// with the same singletons have the same candidate state, so a refuted state can be skipped wherever it turns up again.
+
+#define EXPLORED_SET_WAYS 4  // entries per bucket; one bucket fills a 64 byte cache line
+const int exploredSetEntries = 1 << 16;  // total capacity (rounded to whole buckets); raise for long searches
+
+// one refuted state: its hash, and the number of search nodes it took to refute (used to pick eviction victims)
+typedef struct {
+	uint64_t key;
+	uint64_t work;
+} exploredEntry;
+
+uint64_t* zobristKeys = NULL;  // one random key per (cell, value) pair, indexed by cell*boardSize + value-1
+exploredEntry* exploredSet = NULL;
+int exploredSetBuckets;
+
+// explored set counters for this rank
+long long exploredHits = 0;
+long long exploredMisses = 0;
+long long exploredInserts = 0;
+long long exploredEvictions = 0;
+
+/**
+ * generate the next value from a splitmix64 sequence
+ * @param state: the generator state, advanced in place
+ * @returns: a pseudorandom 64 bit value
+ */
+uint64_t splitmix64(uint64_t* state) {
+	uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/**
+ * initialize the Zobrist keys and the empty explored set for the current board size. the keys come from a fixed seed, so every
+ * rank computes the same hash for the same state.
+ */
+void initExploredSet() {
+	int numCells = boardSize*boardSize;
+	uint64_t seed = 0x5D0C0B0A2D5EEDULL;
+	zobristKeys = malloc(numCells*boardSize*sizeof(uint64_t));
+	for (int i = 0; i < numCells*boardSize; ++i)
+		zobristKeys[i] = splitmix64(&seed);
+	exploredSetBuckets = exploredSetEntries / EXPLORED_SET_WAYS;
+	exploredSet = calloc(exploredSetBuckets*EXPLORED_SET_WAYS, sizeof(exploredEntry));
+}
+
+/**
+ * empty the explored set, such as between benchmark runs that shouldn't benefit from one another's work
+ */
+void resetExploredSet() {
+	memset(exploredSet, 0, exploredSetBuckets*EXPLORED_SET_WAYS*sizeof(exploredEntry));
+}
+
+/**
+ * get the Zobrist key for a cell holding a single value
+ * @param cell: the index (row*boardSize + col) of the cell
+ * @param cands: the cell's candidate set, which must be a singleton
+ * @returns: the key to XOR into the state hash
+ */
+static inline uint64_t zobristKey(int cell, candidateSet cands) {
+	return zobristKeys[cell*boardSize + __builtin_ctzll(cands)];
+}
+
+/**
+ * check whether a state has already been refuted
+ * @param hash: the state's Zobrist hash
+ * @returns: whether the state is in the explored set (true) or not (false)
+ */
+bool exploredSetContains(uint64_t hash) {
+	// a zero key marks an empty entry, so the (astronomically unlikely) zero hash is stored as 1
+	uint64_t key = hash ? hash : 1;
+	exploredEntry* bucket = &exploredSet[(hash % exploredSetBuckets)*EXPLORED_SET_WAYS];
+	for (int i = 0; i < EXPLORED_SET_WAYS; ++i) {
+		if (bucket[i].key == key) {
+			++exploredHits;
+			return true;
+		}
+	}
+	++exploredMisses;
+	return false;
+}
+
+/**
+ * record a refuted state. when its bucket is full, the entry that took the least work to refute is evicted, keeping the
+ * expensive subtrees that are most worth skipping.
+ * @param hash: the state's Zobrist hash
+ * @param work: the number of search nodes it took to refute the state
+ */
+void exploredSetInsert(uint64_t hash, long long work) {
+	uint64_t key = hash ? hash : 1;
+	exploredEntry* bucket = &exploredSet[(hash % exploredSetBuckets)*EXPLORED_SET_WAYS];
+	exploredEntry* victim = &bucket[0];
+	for (int i = 0; i < EXPLORED_SET_WAYS; ++i) {
+		if (bucket[i].key == key || bucket[i].key == 0) {
+			victim = &bucket[i];
+			break;
+		}
+		if (bucket[i].work < victim->work)
+			victim = &bucket[i];
+	}
+	if (victim->key != 0 && victim->key != key)
+		++exploredEvictions;
+	victim->key = key;
+	victim->work = work;
+	++exploredInserts;
+}
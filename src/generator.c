@@ -2,9 +2,19 @@
 #include <stdlib.h>
 #include <math.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
 #include <time.h>
+#include <string.h>
+#include <getopt.h>
 #include <mpi.h>
 #include "solver.h"
+#include "puzzleio.h"
+#include "lanes.h"
+#include "batch.h"
+#include "bulkgen.h"
+#include "engines.h"
+#include "benchmark.h"
 
 // #define BGQ 1 // when running BG/Q, comment out when testing on mastiff
 #ifdef BGQ
@@ -15,17 +25,29 @@
 #define processor_frequency 1.0 // 1.0 for mastiff since Wtime measures seconds, not cycles
 #endif
 
+// formats a single board can be loaded in, besides the puzzle formats
+#define INPUT_FORMAT_AUTO -1  // either puzzle format, detected from the file, or failing that the grid format
+#define INPUT_FORMAT_GRID 2  // boardSize*boardSize whitespace-separated cell values
+
+// how much the generator prints about solving a single board
+#define PRINT_FULL 0  // the generated and solved boards, and every counter
+#define PRINT_SUMMARY 1  // one CSV row per solve
+#define PRINT_NONE 2  // nothing; the exit status says whether every solve succeeded
+
 // MPI data
 int numRanks = -1; // total number of ranks in the current run
 int rank = -1; // our rank
 int numPeers; // number of peers per cell
 
 // puzzle data
-const int boardSize = 9;  // size of both board dimensions
-const int removePercent = 55;  // what percentage of cells to remove
+int boardSize = 9;  // size of both board dimensions; any perfect square from 4 to 64, set with --size
+int removePercent = 55;  // what percentage of cells to remove, set with --remove
 int regionSize;
 int** board;
-int**** peers;
+uint16_t* peers;  // numPeers peer cell indices per cell
+uint16_t* units;  // boardSize member cell indices per row, column and region unit
+uint16_t* cellUnits;  // row, column and region unit indices per cell
+uint64_t randState[4];  // this rank's random stream, seeded by seedRandom
 
 /**
  * allocate a contiguous 2d array of ints
@@ -51,36 +73,43 @@ void dealloc_2d_int(int **arr) {
 }
 
 /**
- * allocate a contiguous 3d array of ints
- * @param x: number of values in the first dimension
- * @param y: number of values in the second dimension
- * @param z: number of values in the third dimension
- * @returns: a dynamically allocated contiguous 3d array of dims x x y x z
+ * get the next value from this rank's xoshiro256** random stream
+ * @returns: a pseudorandom 64 bit value
  */
-int ***alloc_3d_int(int x, int y, int z) {
-	int *p = (int*) malloc(x * y * z * sizeof(int));
-	int ***q = (int***) malloc(x * sizeof(int**));
-	for (int i = 0; i < x; i++) {
-		q[i] = (int**) malloc(y * sizeof(int*));
-		for (int j = 0; j < y; j++) {
-			int idx = x*j + x*y*i;
-			q[i][j] = &p[idx];
-		}
-	}
-	return q;
+uint64_t randNext() {
+	uint64_t result = randState[1] * 5;
+	result = ((result << 7) | (result >> 57)) * 9;
+	uint64_t t = randState[1] << 17;
+	randState[2] ^= randState[0];
+	randState[3] ^= randState[1];
+	randState[1] ^= randState[2];
+	randState[0] ^= randState[3];
+	randState[2] ^= t;
+	randState[3] = (randState[3] << 45) | (randState[3] >> 19);
+	return result;
 }
 
 /**
- * deallocate a contiguous 3d array of ints
- * @param x: number of values in the first dimension
- * @param arr: the array we wish to free
+ * seed this rank's random stream. every rank seeds from the same value, then jumps ahead 2^128 values per rank,
+ * so that the ranks draw from non-overlapping stretches of one xoshiro256** sequence.
+ * @param seed: the seed shared by every rank
  */
-void dealloc_3d_int(int x, int ***arr) {
-	free(arr[0][0]);
-	for(int i = 0; i < x; i++) {
-		free(arr[i]);
+void seedRandom(uint64_t seed) {
+	for (int i = 0; i < 4; ++i)
+		randState[i] = splitmix64(&seed);
+	static const uint64_t jump[4] = {0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL, 0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL};
+	for (int r = 0; r < rank; ++r) {
+		uint64_t jumped[4] = {0, 0, 0, 0};
+		for (int i = 0; i < 4; ++i) {
+			for (int b = 0; b < 64; ++b) {
+				if (jump[i] & (uint64_t)1 << b)
+					for (int k = 0; k < 4; ++k)
+						jumped[k] ^= randState[k];
+				randNext();
+			}
+		}
+		memcpy(randState, jumped, sizeof(jumped));
 	}
-	free(arr);
 }
 
 /**
@@ -90,7 +119,7 @@ void dealloc_3d_int(int x, int ***arr) {
  * @returns: a random integer between min (inclusive) and max (inclusive)
  */
 int randInt(int min, int max) {
-	return min + rand() / (RAND_MAX / (max - min + 1) + 1);
+	return min + (int)(((randNext() >> 32) * (uint64_t)(max - min + 1)) >> 32);
 }
 
 /**
@@ -104,37 +133,27 @@ void initBoard() {
 }
 
 /**
- * initialize the peers list to a 4d array of boardSize x boardSize x numPeers x 2
+ * initialize the flat, read-only peer and unit tables shared by the generator and every solver.
+ * peers holds numPeers cell indices (row*boardSize + col) per cell; units holds boardSize cell indices per unit
+ * (rows, then columns, then regions); cellUnits holds the row, column and region unit of each cell.
  */
 void initPeers() {
-	peers = malloc(boardSize * sizeof(int*));
-	// init all 4 dimensions first
-	for (int i = 0; i < boardSize; ++i) {
-		peers[i] = malloc(boardSize * sizeof(int*));
-		for (int r = 0; r < boardSize; ++r) {
-			peers[i][r] = malloc(numPeers * sizeof(int*));
-			for (int k = 0; k < numPeers; ++k) {
-				peers[i][r][k] = malloc(2 * sizeof(int));
-			}
-		}
-	}
+	int numCells = boardSize*boardSize;
+	peers = malloc(numCells*numPeers*sizeof(uint16_t));
+	units = malloc(3*boardSize*boardSize*sizeof(uint16_t));
+	cellUnits = malloc(numCells*3*sizeof(uint16_t));
 
-	// now add peer row,col pairs to each cell
+	// add peer cell indices to each cell
 	for (int row = 0; row < boardSize; ++row) {
 		for (int col = 0; col < boardSize; ++col) {
+			uint16_t* cellPeers = &peers[(row*boardSize + col)*numPeers];
 			int peerInd = 0;
 			// row/col peers
 			for (int k = 0; k < boardSize; ++k) {
-				if (k!=row) {
-					peers[row][col][peerInd][0] = k;
-					peers[row][col][peerInd][1] = col;
-					++peerInd;
-				}
-				if (k!=col) {
-					peers[row][col][peerInd][0] = row;
-					peers[row][col][peerInd][1] = k;
-					++peerInd;
-				}
+				if (k!=row)
+					cellPeers[peerInd++] = k*boardSize + col;
+				if (k!=col)
+					cellPeers[peerInd++] = row*boardSize + k;
 			}
 
 			//region peers
@@ -144,13 +163,27 @@ void initPeers() {
 				for (int r = 0; r < regionSize; ++r) {
 					if (regionRow+i == row || regionCol+r == col)
 						continue;
-					peers[row][col][peerInd][0] = regionRow + i;
-					peers[row][col][peerInd][1] = regionCol + r;
-					++peerInd;
+					cellPeers[peerInd++] = (regionRow + i)*boardSize + regionCol + r;
 				}
 			}
 		}
 	}
+
+	// add member cell indices to each row, column and region unit, and record the units of each cell
+	for (int u = 0; u < boardSize; ++u) {
+		int regionRow = u/regionSize*regionSize, regionCol = u%regionSize*regionSize;
+		for (int k = 0; k < boardSize; ++k) {
+			units[u*boardSize + k] = u*boardSize + k;
+			units[(boardSize + u)*boardSize + k] = k*boardSize + u;
+			units[(2*boardSize + u)*boardSize + k] = (regionRow + k/regionSize)*boardSize + regionCol + k%regionSize;
+		}
+	}
+	for (int cell = 0; cell < numCells; ++cell) {
+		int row = cell/boardSize, col = cell%boardSize;
+		cellUnits[cell*3] = row;
+		cellUnits[cell*3 + 1] = boardSize + col;
+		cellUnits[cell*3 + 2] = 2*boardSize + row/regionSize*regionSize + col/regionSize;
+	}
 }
 
 /**
@@ -184,66 +217,43 @@ void printBoard() {
 }
 
 /**
- * insert an integer in place into a sorted integer array
- * @param arr: the array in which to insert the specified value
- * @param newVal: the value to insert into the array
- * @param arrLen: the number of elements currently stored in the array (we assume at least 1 additional slot is available for insertion)
- */
-void insertInPlace(int *arr, int newVal, int arrLen) {
-	int i;
-	for (i=arrLen-1; i >= 0  && arr[i] > newVal; --i) arr[i+1] = arr[i];
-	arr[i+1] = newVal;
-}
-
-/**
- * determine whether or not the board is in a solved state (adheres to all sudoku rules)
+ * determine whether or not the board is in a solved state (adheres to all sudoku rules), in a single pass over its cells.
+ * every unit has boardSize cells, so it holds each value exactly once if and only if the union of its values is every value.
  * @param iBoard: 2d array containing the board data
  * @returns: whether the board is solved (true) or unsolved (false)
  */
 bool boardIsSolved(int** iBoard) {
-	// check for row/col duplicates
+	candidateSet rowUsed[boardSize], colUsed[boardSize], regionUsed[boardSize];
 	for (int i = 0; i < boardSize; ++i)
-		for (int r = 0; r < boardSize; ++r)
-			for (int k = 0; k < boardSize; ++k)
-				if ((iBoard[i][k] == iBoard[i][r] && k != r) || (iBoard[k][r] == iBoard[i][r] && k != i)) return false;
-
-	// check for region duplicates
-	int regionVals[boardSize];
-	for (int i = 0; i < regionSize; ++i) {
-		for (int r = 0; r < regionSize; ++r) {
-			for (int j = 0; j < regionSize; ++j) {
-				for (int k = 0; k < regionSize; ++k) {
-					insertInPlace(regionVals, iBoard[i*regionSize + j][r*regionSize + k], j*regionSize+k);
-				}
-			}
-			if (regionVals[0] == 0) return false;
-			for (int i = 1; i < boardSize; ++i)
-				if (regionVals[i] != regionVals[i-1]+1) return false;
+		rowUsed[i] = colUsed[i] = regionUsed[i] = 0;
+	for (int row = 0; row < boardSize; ++row) {
+		for (int col = 0; col < boardSize; ++col) {
+			int val = iBoard[row][col];
+			if (val < 1 || val > boardSize) return false;
+			rowUsed[row] |= candBit(val);
+			colUsed[col] |= candBit(val);
+			regionUsed[regionOf(row, col)] |= candBit(val);
 		}
 	}
+	for (int i = 0; i < boardSize; ++i)
+		if ((rowUsed[i] & colUsed[i] & regionUsed[i]) != candAll()) return false;
 	return true;
 }
 
 /**
- * determine whether or not a single cell on the board adheres to the sudoku rules
+ * determine whether or not a single cell on the board adheres to the sudoku rules. searches that place values one at a time
+ * should keep placementMasks instead, which answer the same question in O(1).
  * @param row: the row of the cell we wish to check for validity
  * @param col: the column of the cell we wish to check for validity
  * @param iBoard: 2d array containing the board data
  * @returns: whether the cell at iBoard[row][col] is valid (true) or not (false)
  */
 bool cellIsValid(int row, int col, int** iBoard) {
-	// check for row/col duplicates
-	for (int k = 0; k < boardSize; ++k)
-		if ((iBoard[row][k] == iBoard[row][col] && k != col) || (iBoard[k][col] == iBoard[row][col] && k != row)) return false;
-
-	//check for region duplicates
-	int regionRow = row-(row%regionSize);
-	int regionCol = col-(col%regionSize);
-	for (int i = 0; i < regionSize; ++i) {
-		for (int r = 0; r < regionSize; ++r) {
-			if (iBoard[regionRow + i][regionCol + r] == iBoard[row][col] && !(regionRow + i == row && regionCol + r == col)) return false;
-		}
-	}
+	// check each of the cell's peers (the other cells in its row, column and region) once
+	int val = iBoard[row][col];
+	uint16_t* cellPeers = &peers[(row*boardSize + col)*numPeers];
+	for (int i = 0; i < numPeers; ++i)
+		if (iBoard[cellPeers[i]/boardSize][cellPeers[i]%boardSize] == val) return false;
 	return true;
 }
 
@@ -305,9 +315,10 @@ void swapCols(int c1, int c2) {
 }
 
 /**
- * generate a boardSize x boardSize board
+ * generate a complete, valid boardSize x boardSize board by shuffling the digits, rows and columns of a patterned board
+ * @param verbose: whether to print the board once it's generated
  */
-void generateBoard() {
+void generateSolvedBoard(bool verbose) {
 	// start with repeated regions, offset by regionSize
 	for (int i = 0; i < boardSize; ++i) {
 		for (int r = 0; r < boardSize; ++r) {
@@ -371,89 +382,587 @@ void generateBoard() {
 		}
 	}
 
-	puts("Finished generating board:");
-	printBoard();
-	puts(boardIsSolved(board) ? "Board passed validation test" : "Board failed validation test");
+	if (verbose) {
+		puts("Finished generating board:");
+		printBoard();
+		puts(boardIsSolved(board) ? "Board passed validation test" : "Board failed validation test");
+	}
+}
+
+/**
+ * fill an array with the cell indices in a random order (Fisher-Yates shuffle)
+ * @param order: the array to fill, with room for boardSize*boardSize cells
+ */
+void shuffleCellOrder(int* order) {
+	int numCells = boardSize*boardSize;
+	for (int i = 0; i < numCells; ++i)
+		order[i] = i;
+	for (int i = numCells-1; i > 0; --i) {
+		int j = randInt(0,i);
+		int swp = order[i];
+		order[i] = order[j];
+		order[j] = swp;
+	}
+}
 
-	// remove cells at random until we reach the defined threshold
+/**
+ * generate a boardSize x boardSize board, then remove removePercent of its cells at random (without regard to uniqueness)
+ * @param verbose: whether to print the board before and after removal
+ */
+void generateBoard(bool verbose) {
+	generateSolvedBoard(verbose);
+
+	// remove cells in a random order until we reach the defined threshold
 	int removeNum = boardSize*boardSize * (removePercent/100.0f);
-	printf("Removing %d cells (%d%% removal threshold)\n",removeNum, removePercent);
-	for (int i = 0; i < removeNum; ++i) {
-		int row = randInt(0,boardSize-1);
-		int col = randInt(0,boardSize-1);
-		if (board[row][col] == 0) {
-			--i;
-			continue;
+	if (verbose) printf("Removing %d cells (%d%% removal threshold)\n",removeNum, removePercent);
+	int order[boardSize*boardSize];
+	shuffleCellOrder(order);
+	for (int i = 0; i < removeNum; ++i)
+		board[order[i]/boardSize][order[i]%boardSize] = 0;
+
+	// print final board output
+	if (verbose) {
+		puts("Stripped board:");
+		printBoard();
+	}
+}
+
+/**
+ * generate a board whose puzzle has a unique solution, using every rank in a communicator; all of its ranks must call this together.
+ * cells are considered for removal in a random order, with each rank checking a different candidate removal at once,
+ * and a removal is only kept if the puzzle still has exactly one solution.
+ * @param comm: the ranks sharing the work (MPI_COMM_SELF for a rank generating puzzles on its own)
+ * @param targetClues: stop once the puzzle is down to this many clues (0 removes as many cells as possible)
+ * @param targetDifficulty: stop once counting the puzzle's solutions takes at least this many search nodes (0 for no difficulty target)
+ * @param verbose: whether the communicator's rank 0 should print the boards and removal stats
+ */
+void generateUniqueBoard(MPI_Comm comm, int targetClues, long long targetDifficulty, bool verbose) {
+	int numCells = boardSize*boardSize;
+	int commRank, commSize;
+	MPI_Comm_rank(comm, &commRank);
+	MPI_Comm_size(comm, &commSize);
+	int* order = malloc(numCells*sizeof(int));
+	if (commRank == 0) {
+		generateSolvedBoard(verbose);
+		shuffleCellOrder(order);
+	}
+	MPI_Bcast(&(board[0][0]), numCells, MPI_INT, 0, comm);
+	MPI_Bcast(order, numCells, MPI_INT, 0, comm);
+
+	// order[0..numCandidates) holds the cells still worth trying to remove. a removal that breaks uniqueness is dropped for good, as
+	// removing further clues can only add solutions; of the removals that keep the puzzle unique, the first is applied and the rest
+	// are retried against the new puzzle
+	int clues = numCells, numCandidates = numCells, numRounds = 0, numRejected = 0;
+	long long difficulty = 0;
+	long long* results = malloc(2*commSize*sizeof(long long));
+	while (numCandidates > 0 && clues > targetClues && (targetDifficulty <= 0 || difficulty < targetDifficulty)) {
+		int roundSize = numCandidates < commSize ? numCandidates : commSize;
+		long long result[2] = {0, 0};  // whether our candidate removal keeps the puzzle unique, and the search nodes it took to check
+		if (commRank < roundSize) {
+			int row = order[commRank]/boardSize, col = order[commRank]%boardSize;
+			int val = board[row][col];
+			board[row][col] = 0;
+			result[0] = boardHasUniqueSolution(board, &result[1]);
+			board[row][col] = val;
 		}
-		board[row][col] = 0;
+		MPI_Allgather(result, 2, MPI_LONG_LONG, results, 2, MPI_LONG_LONG, comm);
+
+		int numKept = 0;
+		bool applied = false;
+		for (int i = 0; i < roundSize; ++i) {
+			if (!results[2*i])
+				++numRejected;
+			else if (!applied) {
+				board[order[i]/boardSize][order[i]%boardSize] = 0;
+				--clues;
+				difficulty = results[2*i+1];
+				applied = true;
+			}
+			else
+				order[numKept++] = order[i];
+		}
+		memmove(&order[numKept], &order[roundSize], (numCandidates-roundSize)*sizeof(int));
+		numCandidates = numKept + numCandidates-roundSize;
+		++numRounds;
 	}
 
-	// print final board output
-	puts("Stripped board:");
-	printBoard();
+	if (verbose && commRank == 0) {
+		printf("Removed %d cells in %d rounds across %d ranks (%d removals rejected): %d clues left, difficulty %lld search nodes\n",
+			numCells-clues, numRounds, commSize, numRejected, clues, difficulty);
+		puts("Stripped board:");
+		printBoard();
+	}
+	free(results);
+	free(order);
 }
 
 /**
- * create the board from the data located in the specified file
+ * create the board from the first puzzle in the specified file, which may be in either puzzle format, or
+ * boardSize*boardSize whitespace-separated cell values (as written by writeBoardToFile.py)
  * @param fName: the name of the file from which to load the board
+ * @param format: PUZZLE_FORMAT_TEXT, PUZZLE_FORMAT_BINARY or INPUT_FORMAT_GRID, or INPUT_FORMAT_AUTO to try the puzzle formats
+ * and then the grid format
+ * @param verbose: whether to print the loaded board
  */
-void readBoardFromFile(char fName[]) {
-	FILE * fp;
-	if ((fp = fopen(fName, "r")) == NULL) {
-		fprintf(stderr,"Unable to locate file %s\n",fName);
-		exit(EXIT_FAILURE);
+void readBoardFromFile(char fName[], int format, bool verbose) {
+	bool found = false;
+	if (format != INPUT_FORMAT_GRID) {
+		puzzleReader reader;
+		if (!puzzleReaderOpen(&reader, fName))
+			exit(EXIT_FAILURE);
+		unsigned char cells[boardSize*boardSize];
+		// when detecting the format, probe quietly, as a grid file is nothing but malformed puzzle lines; once the file turns out to
+		// hold a puzzle, read it again with warnings for any lines skipped on the way
+		size_t start = reader.offset;
+		reader.quiet = format == INPUT_FORMAT_AUTO;
+		found = (format == INPUT_FORMAT_AUTO || format == reader.format) && puzzleReaderNext(&reader, cells);
+		if (found && reader.quiet) {
+			reader.offset = start;
+			reader.index = 0;
+			reader.quiet = false;
+			puzzleReaderNext(&reader, cells);
+		}
+		puzzleReaderClose(&reader);
+		if (found) {
+			for (int i = 0; i < boardSize*boardSize; ++i)
+				board[i/boardSize][i%boardSize] = cells[i];
+		}
+		else if (format != INPUT_FORMAT_AUTO) {
+			fprintf(stderr,"No %s puzzle found in %s\n", format == PUZZLE_FORMAT_BINARY ? "binary" : "text", fName);
+			exit(EXIT_FAILURE);
+		}
 	}
-	for (int i = 0; i < boardSize*boardSize; ++i) {
-		int t = fscanf(fp,"%d ",&board[i/boardSize][i%boardSize]);
-		if (t == 0) {
-			fprintf(stderr,"Error reading board data from %s\n",fName);
+	if (!found) {
+		FILE * fp = fopen(fName, "r");
+		if (fp == NULL) {
+			fprintf(stderr,"Unable to open file %s for reading\n",fName);
 			exit(EXIT_FAILURE);
 		}
+		for (int i = 0; i < boardSize*boardSize; ++i) {
+			int t = fscanf(fp,"%d ",&board[i/boardSize][i%boardSize]);
+			if (t != 1) {
+				fprintf(stderr,"Error reading board data from %s\n",fName);
+				exit(EXIT_FAILURE);
+			}
+		}
+		fclose(fp);
 	}
-	fclose(fp);
 
-	puts("Finished loading board:");
-	printBoard();
+	if (verbose) {
+		puts("Finished loading board:");
+		printBoard();
+	}
 }
 
-int main(int argc, char *argv[]) {
-	// init random using current time in seconds as seed
-	srand(time(0));
+/**
+ * convert a single puzzle character to a cell value: '0' or '.' for blank, '1'-'9' for 1-9, then 'A'-'Z' and 'a'-'z' for 10 and up
+ * @param c: the character to convert
+ * @returns: the cell value, or -1 if c isn't a valid cell value for the current board size
+ */
+int cellValueFromChar(char c) {
+	int val = -1;
+	if (c == '.') val = 0;
+	else if (c >= '0' && c <= '9') val = c - '0';
+	else if (c >= 'A' && c <= 'Z') val = c - 'A' + 10;
+	else if (c >= 'a' && c <= 'z') val = c - 'a' + 36;
+	return val <= boardSize ? val : -1;
+}
 
+/**
+ * convert a cell value to its single puzzle character, the inverse of cellValueFromChar; blank cells become '.'
+ * @param val: the cell value to convert
+ * @returns: the character representing val
+ */
+char cellValueToChar(int val) {
+	if (val == 0) return '.';
+	if (val <= 9) return '0' + val;
+	if (val <= 35) return 'A' + val - 10;
+	return 'a' + val - 36;
+}
+
+/**
+ * solve each puzzle in the specified file with the serial CP solver, reporting the search node rate for each and for the full set
+ * @param fName: the name of the puzzle file, in either puzzle format
+ */
+void nodeRateBenchmark(char fName[]) {
+	puzzleReader reader;
+	if (!puzzleReaderOpen(&reader, fName))
+		exit(EXIT_FAILURE);
+	unsigned char cells[boardSize*boardSize];
+	int numPuzzles = 0;
+	long long startNodes = totalNodes;
+	double totalSecs = 0;
+	while (puzzleReaderNext(&reader, cells)) {
+		for (int i = 0; i < boardSize*boardSize; ++i)
+			board[i/boardSize][i%boardSize] = cells[i];
+		long long puzzleStartNodes = totalNodes;
+		double g_start_cycles = GetTimeBase();
+		serialCPSolver(board);
+		double time_in_secs = (GetTimeBase() - g_start_cycles) / processor_frequency;
+		long long puzzleNodes = totalNodes - puzzleStartNodes;
+		printf("puzzle %d: %lld nodes in %fs (%.0f nodes/sec)%s\n", ++numPuzzles, puzzleNodes, time_in_secs, puzzleNodes / time_in_secs,
+			boardIsSolved(board) ? "" : " - failed validation test");
+		totalSecs += time_in_secs;
+	}
+	puzzleReaderClose(&reader);
+	printf("%d puzzles: %lld nodes in %fs (%.0f nodes/sec)\n", numPuzzles, totalNodes - startNodes, totalSecs, (totalNodes - startNodes) / totalSecs);
+}
+
+/**
+ * gather each rank's solve time and search node count on rank 0, and print them, followed by the instrumentation counters and
+ * load balance summary when they are compiled in
+ * @param elapsed: the time this rank spent in the solver, in seconds
+ */
+void reportSolveStats(double elapsed) {
+	double solveStats[2] = {elapsed, totalNodes};
+	double* allStats = rank == 0 ? malloc(2*numRanks*sizeof(double)) : NULL;
+	MPI_Gather(solveStats, 2, MPI_DOUBLE, allStats, 2, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+	if (rank == 0) {
+		for (int i = 0; i < numRanks; ++i)
+			printf("rank %d: %fs, %.0f search nodes\n", i, allStats[2*i], allStats[2*i+1]);
+		free(allStats);
+		fflush(stdout);
+	}
+	reportSearchStats(elapsed);
+}
+
+int main(int argc, char *argv[]) {
 	// init MPI + get size & rank, then calculate board data
-	MPI_Init(&argc, &argv);
+	// only the main thread makes MPI calls; hybrid mode's worker threads never touch MPI
+	int threadSupport;
+	MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &threadSupport);
 	MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
 	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
+	// parse command line options
+	char* nodeRateFile = NULL;
+	char* batchFile = NULL;
+	char* outputFile = NULL;
+	long long generateCount = 0;
+	int outputFormat = PUZZLE_FORMAT_TEXT;
+	char* benchFile = NULL;
+	char* benchSolverNames = NULL;
+	uint64_t seed = time(0);
+	int chunkSize = 16;
+	long long countSolutionsLimit = -1;
+	bool uniqueGeneration = false;
+	int targetClues = 0;
+	long long targetDifficulty = 0;
+	solverEngine* engine = findSolverEngine("serialCP");
+	char* inputFile = NULL;
+	int inputFormat = INPUT_FORMAT_AUTO;
+	int repetitions = 1;
+	int printMode = PRINT_FULL;
+	static struct option longOptions[] = {
+		{"node-rate", required_argument, NULL, 'r'},  // benchmark the CP search node rate over a puzzle file instead of solving a single board
+		{"size", required_argument, NULL, 'n'},  // board size (9, 16, 25, 36, ...)
+		{"engine", required_argument, NULL, 'e'},  // solver engine for a single board (default serialCP); see engines.h for the names
+		{"input", required_argument, NULL, 'i'},  // load the board to solve from the first puzzle in this file, instead of generating one
+		{"input-format", required_argument, NULL, 'I'},  // format of the --input file: auto (default), text, binary or grid
+		{"remove", required_argument, NULL, 'm'},  // percentage of cells to remove from a generated board (default 55)
+		{"reps", required_argument, NULL, 'x'},  // solve the board this many times, reporting each solve (default 1)
+		{"print", required_argument, NULL, 'P'},  // what to print about solving a single board: full (default), summary (CSV rows) or none
+		{"batch", required_argument, NULL, 'b'},  // solve every puzzle in a file, handing chunks out to ranks on demand
+		{"output", required_argument, NULL, 'o'},  // file to write batch solutions and timings (default solutions.txt) or generated puzzles (default puzzles.txt) to
+		{"generate", required_argument, NULL, 'g'},  // generate this many puzzles across all ranks, instead of solving a single board
+		{"bench", required_argument, NULL, 'B'},  // benchmark the solvers over a puzzle corpus, appending CSV results to --output (default bench.csv)
+		{"solvers", required_argument, NULL, 'S'},  // comma separated solvers to benchmark (default: all)
+		{"format", required_argument, NULL, 'f'},  // format to write generated puzzles and batch solutions in: text (default) or binary
+		{"seed", required_argument, NULL, 's'},  // random seed shared by every rank (default: the current time)
+		{"chunk", required_argument, NULL, 'c'},  // puzzles handed out per batch request
+		{"no-lanes", no_argument, NULL, 'V'},  // solve batch puzzles one at a time with the serial CP solver, rather than propagating them in vector lanes first
+		{"count", required_argument, NULL, 'k'},  // count the board's solutions up to a limit (0 counts every solution) instead of solving it, with dancing links for the DLX engines and CP otherwise
+		{"unique", no_argument, NULL, 'u'},  // generate a puzzle with a unique solution, checking candidate removals across ranks
+		{"clues", required_argument, NULL, 'l'},  // with --unique, stop removing cells at this many clues
+		{"difficulty", required_argument, NULL, 'd'},  // with --unique, stop once checking uniqueness takes this many search nodes
+		{"threads", required_argument, NULL, 't'},  // worker threads per rank for the hybrid solver (default: one per processor)
+		{"propagation", required_argument, NULL, 'p'},  // propagation level: 0 singles, 1 adds intersections, 2 adds subsets (default), 3 adds X-wings
+		{"restarts", required_argument, NULL, 'R'},  // restart the serial CP search on a Luby schedule of this many nodes per unit (default 0: no restarts)
+		{"nogoods", required_argument, NULL, 'N'},  // with --restarts, carry refuted decision paths of up to this many decisions between runs (default 3, 0 for none)
+		{NULL, 0, NULL, 0}
+	};
+	int opt;
+	while ((opt = getopt_long(argc, argv, "r:n:e:i:I:m:x:P:b:o:c:Vt:p:R:N:k:ul:d:g:s:f:B:S:", longOptions, NULL)) != -1) {
+		switch (opt) {
+			case 'r':
+				nodeRateFile = optarg;
+				break;
+			case 'n':
+				boardSize = atoi(optarg);
+				regionSize = round(sqrt(boardSize));
+				if (boardSize < 4 || boardSize > 64 || regionSize*regionSize != boardSize) {
+					if (rank == 0) fprintf(stderr,"board size must be a perfect square from 4 to 64\n");
+					MPI_Finalize();
+					return EXIT_FAILURE;
+				}
+				break;
+			case 'e':
+				if ((engine = findSolverEngine(optarg)) == NULL) {
+					if (rank == 0) {
+						fprintf(stderr,"unknown engine %s; engines are:", optarg);
+						for (int i = 0; i < numSolverEngines; ++i)
+							fprintf(stderr," %s", solverEngines[i].name);
+						fputc('\n', stderr);
+					}
+					MPI_Finalize();
+					return EXIT_FAILURE;
+				}
+				break;
+			case 'i':
+				inputFile = optarg;
+				break;
+			case 'I':
+				inputFormat = strcmp(optarg, "auto") == 0 ? INPUT_FORMAT_AUTO : strcmp(optarg, "grid") == 0 ? INPUT_FORMAT_GRID : puzzleFormatFromName(optarg);
+				if (inputFormat == -1 && strcmp(optarg, "auto") != 0) {
+					if (rank == 0) fprintf(stderr,"input format must be auto, text, binary or grid\n");
+					MPI_Finalize();
+					return EXIT_FAILURE;
+				}
+				break;
+			case 'm':
+				removePercent = atoi(optarg);
+				if (removePercent < 0 || removePercent > 100) {
+					if (rank == 0) fprintf(stderr,"removal percentage must be from 0 to 100\n");
+					MPI_Finalize();
+					return EXIT_FAILURE;
+				}
+				break;
+			case 'x':
+				repetitions = atoi(optarg) > 0 ? atoi(optarg) : 1;
+				break;
+			case 'P':
+				printMode = strcmp(optarg, "full") == 0 ? PRINT_FULL : strcmp(optarg, "summary") == 0 ? PRINT_SUMMARY : strcmp(optarg, "none") == 0 ? PRINT_NONE : -1;
+				if (printMode == -1) {
+					if (rank == 0) fprintf(stderr,"print mode must be full, summary or none\n");
+					MPI_Finalize();
+					return EXIT_FAILURE;
+				}
+				break;
+			case 'b':
+				batchFile = optarg;
+				break;
+			case 'o':
+				outputFile = optarg;
+				break;
+			case 'c':
+				chunkSize = atoi(optarg) > 0 ? atoi(optarg) : 1;
+				break;
+			case 'V':
+				batchLanes = false;
+				break;
+			case 'k': {
+				char* end;
+				countSolutionsLimit = strtoll(optarg, &end, 10);
+				if (end == optarg || *end != '\0' || countSolutionsLimit < 0) {
+					if (rank == 0) fprintf(stderr,"solution limit must be a whole number, 0 to count every solution\n");
+					MPI_Finalize();
+					return EXIT_FAILURE;
+				}
+				break;
+			}
+			case 'g':
+				generateCount = atoll(optarg);
+				break;
+			case 'B':
+				benchFile = optarg;
+				break;
+			case 'S':
+				benchSolverNames = optarg;
+				break;
+			case 'f':
+				if ((outputFormat = puzzleFormatFromName(optarg)) == -1) {
+					if (rank == 0) fprintf(stderr,"output format must be text or binary\n");
+					MPI_Finalize();
+					return EXIT_FAILURE;
+				}
+				break;
+			case 's':
+				seed = strtoull(optarg, NULL, 0);
+				break;
+			case 'u':
+				uniqueGeneration = true;
+				break;
+			case 'l':
+				uniqueGeneration = true;
+				targetClues = atoi(optarg);
+				break;
+			case 'd':
+				uniqueGeneration = true;
+				targetDifficulty = atoll(optarg);
+				break;
+			case 't':
+				hybridThreads = atoi(optarg) > 0 ? atoi(optarg) : 1;
+				break;
+			case 'p':
+				cpLevel = atoi(optarg);
+				if (cpLevel < CP_LEVEL_SINGLES || cpLevel > CP_MAX_LEVEL) {
+					if (rank == 0) fprintf(stderr,"propagation level must be from %d to %d\n", CP_LEVEL_SINGLES, CP_MAX_LEVEL);
+					MPI_Finalize();
+					return EXIT_FAILURE;
+				}
+				break;
+			case 'R':
+				cpRestartUnit = atoll(optarg) > 0 ? atoll(optarg) : 0;
+				break;
+			case 'N':
+				cpNogoodSize = atoi(optarg);
+				if (cpNogoodSize < 0 || cpNogoodSize > NOGOOD_MAX_SIZE) {
+					if (rank == 0) fprintf(stderr,"nogood size must be from 0 to %d\n", NOGOOD_MAX_SIZE);
+					MPI_Finalize();
+					return EXIT_FAILURE;
+				}
+				break;
+			default:
+				if (rank == 0) fprintf(stderr,"usage: %s [--size boardSize] [--engine name] [--input boardFile [--input-format auto|text|binary|grid]] [--remove percent] [--reps count] [--print full|summary|none] [--node-rate puzzleFile] [--batch puzzleFile [--output solutionFile] [--chunk puzzlesPerRequest] [--no-lanes]] [--threads threadsPerRank] [--propagation level] [--restarts nodesPerUnit [--nogoods maxDecisions]] [--count solutionLimit] [--unique [--clues targetClues] [--difficulty targetNodes]] [--generate numPuzzles [--output puzzleFile]] [--format text|binary] [--seed seed] [--bench corpusFile [--solvers names] [--output csvFile]]\n", argv[0]);
+				MPI_Finalize();
+				return EXIT_FAILURE;
+		}
+	}
+
+	// the hybrid solver's worker threads need an MPI that allows other threads alongside the one making MPI calls; without it,
+	// an explicit thread count is an error, and otherwise the hybrid solver searches on the main thread alone
+	if (threadSupport < MPI_THREAD_FUNNELED) {
+		if (hybridThreads > 1) {
+			if (rank == 0) fprintf(stderr,"--threads %d needs MPI_THREAD_FUNNELED, but this MPI only provides MPI_THREAD_SINGLE\n", hybridThreads);
+			MPI_Finalize();
+			return EXIT_FAILURE;
+		}
+		hybridThreadsAllowed = false;
+	}
+
 	// everyone allocates memory for the starting board
 	regionSize = sqrt(boardSize);
 	numPeers = 2*(boardSize-1) + regionSize*regionSize - 2*(regionSize-1) - 1;
 	initBoard();
 	initPeers();
+	initExploredSet();
 
-	// rank 0 runs the board generation algorithm
-	if (rank == 0) {
-		puts("-----Generating board-----");
+	// rank 0 measures the CP node rate over the specified puzzles rather than solving a single board
+	if (nodeRateFile != NULL) {
+		if (rank == 0) nodeRateBenchmark(nodeRateFile);
+		MPI_Finalize();
+		return EXIT_SUCCESS;
+	}
+
+	// every rank draws from its own stretch of one random sequence, seeded from rank 0's seed
+	MPI_Bcast(&seed, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+	seedRandom(seed);
+
+	// all ranks work through the puzzles in the batch file rather than solving a single board
+	if (batchFile != NULL) {
+		batchSolve(batchFile, outputFile != NULL ? outputFile : "solutions.txt", outputFormat, chunkSize);
+		MPI_Finalize();
+		return EXIT_SUCCESS;
+	}
+
+	// all ranks benchmark the solvers over a corpus
+	if (benchFile != NULL) {
+		benchmarkCorpus(benchFile, benchSolverNames, outputFile != NULL ? outputFile : "bench.csv");
+		MPI_Finalize();
+		return EXIT_SUCCESS;
+	}
+
+	// all ranks generate puzzles independently, writing them to a shared file
+	if (generateCount > 0) {
+		bulkGenerate(generateCount, outputFile != NULL ? outputFile : "puzzles.txt", outputFormat, uniqueGeneration, targetClues, targetDifficulty);
+		MPI_Finalize();
+		return EXIT_SUCCESS;
+	}
+
+	// rank 0 loads or runs the board generation algorithm, unless all ranks are helping to generate a unique puzzle
+	bool verbose = printMode == PRINT_FULL;
+	if (rank == 0 && verbose) {
+		puts(inputFile != NULL ? "-----Loading board-----" : "-----Generating board-----");
 		fflush(stdout);
-		//readBoardFromFile("boardFile.txt");  // *use me to load an existing board for testing / performance analysis
-		generateBoard();  // *use me to generate a new board at random
+	}
+	if (inputFile != NULL) {
+		if (rank == 0) readBoardFromFile(inputFile, inputFormat, verbose);
+	}
+	else if (uniqueGeneration)
+		generateUniqueBoard(MPI_COMM_WORLD, targetClues, targetDifficulty, verbose);
+	else if (rank == 0)
+		generateBoard(verbose);
+	if (rank == 0 && verbose) {
 		puts("\n-----Solving Board-----");
 		fflush(stdout);
 	}
 	// rank 0 sends initial board to all other ranks
 	MPI_Bcast(&(board[0][0]), boardSize*boardSize, MPI_INT, 0, MPI_COMM_WORLD);
 
-	// analyze solver performance
-	double g_start_cycles = GetTimeBase();
-	if (serialCPSolver(board)) {  // replace me with your desired solver method
-		// rather than bogging down performance with passive recv tests, the first rank to find a solution outputs the result and aborts
+	// count the board's solutions across all ranks rather than solving it, with the engine's counter
+	if (countSolutionsLimit >= 0) {
+		double g_start_cycles = GetTimeBase();
+		long long numSolutions = engine->countSolutions(board, countSolutionsLimit);
 		double time_in_secs = (GetTimeBase() - g_start_cycles) / processor_frequency;
-		printf("rank %d Solved board (elapsed time %fs):\n",rank, time_in_secs);
-		printBoard();
-		puts(boardIsSolved(board) ? "Board passed validation test" : "Board failed validation test");
-		if (numRanks > 1) MPI_Abort(MPI_COMM_WORLD,1);
+		if (rank == 0) {
+			if (countSolutionsLimit > 0 && numSolutions == countSolutionsLimit)
+				printf("Board has at least %lld solutions (elapsed time %fs)\n", numSolutions, time_in_secs);
+			else
+				printf("Board has %lld solution%s (elapsed time %fs)\n", numSolutions, numSolutions == 1 ? "" : "s", time_in_secs);
+		}
+		reportSolveStats(time_in_secs);
+		MPI_Finalize();
+		return EXIT_SUCCESS;
+	}
+
+	// analyze solver performance, restoring the starting board before each repetition
+	int numCells = boardSize*boardSize;
+	int* givens = malloc(numCells*sizeof(int));
+	memcpy(givens, &board[0][0], numCells*sizeof(int));
+	if (rank == 0 && printMode == PRINT_SUMMARY)
+		puts("engine,size,ranks,rep,solved,seconds,nodes");
+	int numSolved = 0;
+	double time_in_secs = 0;
+	for (int rep = 0; rep < repetitions; ++rep) {
+		memcpy(&board[0][0], givens, numCells*sizeof(int));
+		resetExploredSet();
+		long long startNodes = totalNodes;
+		MPI_Barrier(MPI_COMM_WORLD);
+		cancelInit();
+		double g_start_cycles = GetTimeBase();
+		bool solved = engine->solve(board);
+		time_in_secs = (GetTimeBase() - g_start_cycles) / processor_frequency;
+		// the first rank to find a solution outputs the result and tells the others to stop searching; every rank then returns with its stats
+		if (solved && cancelAnnounce() && verbose) {
+			printf("rank %d Solved board with %s (elapsed time %fs):\n", rank, engine->name, time_in_secs);
+			printBoard();
+			puts(boardIsSolved(board) ? "Board passed validation test" : "Board failed validation test");
+			if (engine->solve == portfolioSolver)
+				printf("rank %d portfolio configuration: %s\n", rank, portfolioConfigs[rank % PORTFOLIO_NUM_CONFIGS].name);
+			if (totalSweepVisits > 0)
+				printf("rank %d propagation work: %lld cell visits (full-board sweeps would have made %lld)\n", rank, totalPropagationVisits, totalSweepVisits);
+			for (int i = 0; i < CP_NUM_RULES; ++i)
+				if (totalRuleHits[i] > 0)
+					printf("rank %d %s rule: applied %lld times\n", rank, cpRuleNames[i], totalRuleHits[i]);
+			if (totalRestarts > 0 || totalNogoods > 0)
+				printf("rank %d restarts: %lld runs restarted, %lld nogoods recorded, %lld values pruned by nogoods\n", rank, totalRestarts, totalNogoods, totalNogoodPrunes);
+			if (exploredMisses > 0)
+				printf("rank %d explored set: %lld hits, %lld misses, %lld inserts, %lld evictions\n", rank, exploredHits, exploredMisses, exploredInserts, exploredEvictions);
+			fflush(stdout);
+		}
+		int winner = cancelFinish();
+		numSolved += winner >= 0;
+
+		// a solve takes as long as its slowest rank
+		double slowest;
+		long long repNodes = totalNodes - startNodes, nodes;
+		MPI_Reduce(&time_in_secs, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+		MPI_Reduce(&repNodes, &nodes, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+		if (rank == 0) {
+			if (printMode == PRINT_SUMMARY)
+				printf("%s,%d,%d,%d,%d,%f,%lld\n", engine->name, boardSize, numRanks, rep, winner >= 0, slowest, nodes);
+			else if (verbose && winner >= 0)
+				printf("rank %d found the solution\n", winner);
+			else if (verbose)
+				puts("no rank found a solution");
+			fflush(stdout);
+		}
 	}
+	free(givens);
+	if (verbose)
+		reportSolveStats(time_in_secs);
+
 	// all done
 	MPI_Finalize();
-	return EXIT_SUCCESS;
+	return numSolved == repetitions ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,462 @@
+// hybrid MPI + shared-memory CP solver: one rank per node (or socket) runs a pool of worker threads doing a task-parallel CP search
+// over lock-free Chase-Lev work deques. The peer, unit and Zobrist tables are shared read-only by every thread. Only the main thread
+// makes MPI calls (MPI_THREAD_FUNNELED); it moves tasks between nodes using the work-stealing scheduler's protocol.
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <unistd.h>
+
+#define HYBRID_DEQUE_CAPACITY 1024  // tasks per deque (a power of two); a worker searches inline rather than spawn into a full deque
+#define HYBRID_SPAWN_THRESHOLD 2  // a worker only spawns a task when its own deque holds fewer than this many
+
+#define HYBRID_IDLE_SPINS 64  // failed steal rounds an idle worker makes, yielding between them, before it parks
+#define HYBRID_PARK_NSEC 1000000  // longest a parked worker sleeps before looking for work again, in case it missed a wake-up
+
+int hybridThreads = 0;  // worker threads per rank; 0 means one per online processor
+bool hybridThreadsAllowed = true;  // MPI lets worker threads run beside the main thread's MPI calls (MPI_THREAD_FUNNELED)
+
+// a unit of work: the candidate state at an open branch, with the branch cell restricted to the values left to try
+typedef struct hybridTask {
+	struct hybridTask* next;  // free list link
+	candidateSet possibleValues[];
+} hybridTask;
+
+// single-owner, multi-thief work deque (Chase and Lev, with the C11 orderings of Le et al.)
+typedef struct {
+	atomic_long top;
+	atomic_long bottom;
+	_Atomic(hybridTask*) slots[HYBRID_DEQUE_CAPACITY];
+} hybridDeque;
+
+// per-thread search state
+typedef struct {
+	int id;
+	pthread_t thread;
+	cpEngine engine;
+	hybridDeque* deque;
+	hybridTask* freeTasks;  // tasks this thread has finished with, reused before calling malloc
+	unsigned long long randState;
+	long long tasksRun;
+} hybridWorker;
+
+// state shared by every thread on this rank
+hybridWorker* hybridWorkers;
+hybridDeque* hybridDeques;  // one per worker, plus one owned by the main thread for work arriving from other ranks
+atomic_long hybridActiveTasks;  // tasks queued or running on this rank
+atomic_bool hybridStop;  // set by the main thread once the search is over everywhere
+atomic_bool hybridSolved;  // set by the first worker to find a solution
+candidateSet* hybridSolution;
+pthread_mutex_t hybridIdleLock = PTHREAD_MUTEX_INITIALIZER;  // guards parking on hybridIdleCond
+pthread_cond_t hybridIdleCond = PTHREAD_COND_INITIALIZER;  // signalled when a task is queued or the search ends
+atomic_int hybridParked;  // workers parked on hybridIdleCond
+
+/**
+ * push a task onto the bottom of a deque; only the deque's owner may push
+ * @param deque: the deque to push onto
+ * @param task: the task to push
+ * @returns: whether the task was pushed (true) or the deque was full (false)
+ */
+bool hybridDequePush(hybridDeque* deque, hybridTask* task) {
+	long b = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+	long t = atomic_load_explicit(&deque->top, memory_order_acquire);
+	if (b - t >= HYBRID_DEQUE_CAPACITY)
+		return false;
+	atomic_store_explicit(&deque->slots[b & (HYBRID_DEQUE_CAPACITY-1)], task, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	atomic_store_explicit(&deque->bottom, b+1, memory_order_relaxed);
+	return true;
+}
+
+/**
+ * pop the most recently pushed task from the bottom of a deque; only the deque's owner may take
+ * @param deque: the deque to take from
+ * @returns: the task, or NULL if the deque is empty or a thief won the race for its last task
+ */
+hybridTask* hybridDequeTake(hybridDeque* deque) {
+	long b = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+	atomic_store_explicit(&deque->bottom, b, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	long t = atomic_load_explicit(&deque->top, memory_order_relaxed);
+	hybridTask* task = NULL;
+	if (t <= b) {
+		task = atomic_load_explicit(&deque->slots[b & (HYBRID_DEQUE_CAPACITY-1)], memory_order_relaxed);
+		if (t == b) {
+			// last task: race any thieves for it
+			if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t+1, memory_order_seq_cst, memory_order_relaxed))
+				task = NULL;
+			atomic_store_explicit(&deque->bottom, b+1, memory_order_relaxed);
+		}
+	}
+	else
+		atomic_store_explicit(&deque->bottom, b+1, memory_order_relaxed);
+	return task;
+}
+
+/**
+ * steal the oldest (shallowest) task from the top of a deque; any thread may steal
+ * @param deque: the deque to steal from
+ * @returns: the task, or NULL if the deque is empty or another thread won the race
+ */
+hybridTask* hybridDequeSteal(hybridDeque* deque) {
+	long t = atomic_load_explicit(&deque->top, memory_order_acquire);
+	atomic_thread_fence(memory_order_seq_cst);
+	long b = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+	if (t >= b)
+		return NULL;
+	hybridTask* task = atomic_load_explicit(&deque->slots[t & (HYBRID_DEQUE_CAPACITY-1)], memory_order_relaxed);
+	if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t+1, memory_order_seq_cst, memory_order_relaxed))
+		return NULL;
+	return task;
+}
+
+/**
+ * get the approximate number of tasks in a deque
+ * @param deque: the deque to measure
+ * @returns: the number of tasks, as seen at some recent instant
+ */
+long hybridDequeSize(hybridDeque* deque) {
+	long size = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - atomic_load_explicit(&deque->top, memory_order_relaxed);
+	return size > 0 ? size : 0;
+}
+
+/**
+ * get a task buffer, reusing one from the free list when possible
+ * @param freeTasks: the free list to take from
+ * @returns: a task with room for boardSize*boardSize candidate sets
+ */
+hybridTask* hybridAllocTask(hybridTask** freeTasks) {
+	hybridTask* task = *freeTasks;
+	if (task != NULL) {
+		*freeTasks = task->next;
+		return task;
+	}
+	return malloc(sizeof(hybridTask) + boardSize*boardSize*sizeof(candidateSet));
+}
+
+/**
+ * steal a task from a random deque other than our own, trying each deque once
+ * @param self: the index of our own deque, which is skipped
+ * @param randState: the caller's xorshift generator state
+ * @returns: the stolen task, or NULL if nothing could be stolen
+ */
+hybridTask* hybridStealAny(int self, unsigned long long* randState) {
+	int numDeques = hybridThreads+1;
+	*randState ^= *randState << 13;
+	*randState ^= *randState >> 7;
+	*randState ^= *randState << 17;
+	int start = *randState % numDeques;
+	for (int i = 0; i < numDeques; ++i) {
+		int victim = (start + i) % numDeques;
+		if (victim == self)
+			continue;
+		hybridTask* task = hybridDequeSteal(&hybridDeques[victim]);
+		if (task != NULL)
+			return task;
+	}
+	return NULL;
+}
+
+/**
+ * determine whether any deque on this rank holds a task
+ * @returns: whether a task was queued (true) or every deque was empty (false), as seen at some recent instant
+ */
+bool hybridAnyQueued() {
+	for (int i = 0; i <= hybridThreads; ++i)
+		if (hybridDequeSize(&hybridDeques[i]) > 0) return true;
+	return false;
+}
+
+/**
+ * wake parked workers: one when a task has been queued, as only one worker can take it, or all of them once the search is over
+ * @param all: whether to wake every parked worker (true) or just one (false)
+ */
+void hybridWake(bool all) {
+	if (atomic_load(&hybridParked) == 0)
+		return;
+	pthread_mutex_lock(&hybridIdleLock);
+	if (all)
+		pthread_cond_broadcast(&hybridIdleCond);
+	else
+		pthread_cond_signal(&hybridIdleCond);
+	pthread_mutex_unlock(&hybridIdleLock);
+}
+
+/**
+ * park an idle worker until a task is queued or the search ends, so that it stops taking processor time from the other threads
+ * and ranks. a task pushed just as the worker parks might not wake it, so it never sleeps longer than HYBRID_PARK_NSEC.
+ */
+void hybridPark() {
+	pthread_mutex_lock(&hybridIdleLock);
+	atomic_fetch_add(&hybridParked, 1);
+	if (!atomic_load(&hybridStop) && !hybridAnyQueued()) {
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_nsec += HYBRID_PARK_NSEC;
+		if (deadline.tv_nsec >= 1000000000) {
+			++deadline.tv_sec;
+			deadline.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(&hybridIdleCond, &hybridIdleLock, &deadline);
+	}
+	atomic_fetch_sub(&hybridParked, 1);
+	pthread_mutex_unlock(&hybridIdleLock);
+}
+
+/**
+ * core recursive task-parallel CP search. when this worker's deque runs low, the untried values at a branch are spawned as a task
+ * for idle threads (or other ranks) to pick up, rather than being searched here.
+ * @param worker: the calling worker
+ * @returns: whether this branch led to a solution (true) or not (false)
+ */
+bool hybridSearch(hybridWorker* worker) {
+	cpEngine* engine = &worker->engine;
+	candidateSet* possibleValues = engine->possibleValues;
+	++engine->nodes;
+	if (atomic_load_explicit(&hybridStop, memory_order_relaxed))
+		return false;
+
+	// run constraint propagation from the changed cells until no new singletons may be created; a cell or unit running out of values is a contradiction
+	if (!cpPropagate(engine))
+		return false;
+
+	// if we have reduced all cell possibilities to singletons, we have either a solution or a contradiction
+	if (!possibilitiesRemain(possibleValues))
+		return true;
+
+	// find the cell with the fewest possibilities and recurse on each potential possibility
+	int fewestCell = fewestPossibilitiesCell(possibleValues);
+	int trailMark = engine->trailLen;
+	candidateSet untried = possibleValues[fewestCell];
+	STAT_ADD(engine->stats, depth, 1);
+	STAT_MAX(engine->stats, maxDepth, engine->stats.depth);
+	while (untried != 0) {
+		candidateSet val = untried & -untried;
+		untried &= ~val;
+		// hand the rest of this branch's values to the pool if our deque is running dry
+		if (untried != 0 && hybridDequeSize(worker->deque) < HYBRID_SPAWN_THRESHOLD) {
+			hybridTask* task = hybridAllocTask(&worker->freeTasks);
+			memcpy(task->possibleValues, possibleValues, engine->numCells*sizeof(candidateSet));
+			task->possibleValues[fewestCell] = untried;
+			atomic_fetch_add(&hybridActiveTasks, 1);
+			if (hybridDequePush(worker->deque, task)) {
+				untried = 0;
+				hybridWake(false);
+			}
+			else {
+				atomic_fetch_sub(&hybridActiveTasks, 1);
+				task->next = worker->freeTasks;
+				worker->freeTasks = task;
+			}
+		}
+		cpSetCandidates(engine, fewestCell, val);
+		cpEnqueueCell(engine, fewestCell);
+		if (hybridSearch(worker))
+			return true;
+		// branch was unsuccessful; revert possible values and try the next branch
+		cpUndo(engine, trailMark);
+		STAT_ADD(engine->stats, backtracks, 1);
+	}
+
+	// all branches failed; a previous guess must have been wrong
+	STAT_ADD(engine->stats, depth, -1);
+	return false;
+}
+
+/**
+ * worker thread body: run tasks from our own deque, stealing from the other deques when it's empty, until the search is over.
+ * a worker that keeps finding nothing to steal parks until there's work again.
+ * @param arg: the hybridWorker for this thread
+ * @returns: NULL
+ */
+void* hybridWorkerMain(void* arg) {
+	hybridWorker* worker = arg;
+	cpEngine* engine = &worker->engine;
+	int idleRounds = 0;
+	while (!atomic_load(&hybridStop)) {
+		hybridTask* task = hybridDequeTake(worker->deque);
+		if (task == NULL)
+			task = hybridStealAny(worker->id, &worker->randState);
+		if (task == NULL) {
+			if (++idleRounds < HYBRID_IDLE_SPINS)
+				sched_yield();
+			else
+				hybridPark();
+			continue;
+		}
+		idleRounds = 0;
+
+		// load the task's state and search it
+		cpLoadState(engine, task->possibleValues);
+		task->next = worker->freeTasks;
+		worker->freeTasks = task;
+		++worker->tasksRun;
+		STAT_TIMER_START(startTime);
+		bool found = hybridSearch(worker);
+		STAT_TIMER_ADD(engine->stats, busyTime, startTime);
+		// a solved task leaves its branches open, so the next task starts back at the root
+		STAT_ADD(engine->stats, depth, -engine->stats.depth);
+		if (found) {
+			bool alreadySolved = false;
+			if (atomic_compare_exchange_strong(&hybridSolved, &alreadySolved, true)) {
+				memcpy(hybridSolution, engine->possibleValues, engine->numCells*sizeof(candidateSet));
+				atomic_store(&hybridStop, true);
+				hybridWake(true);
+			}
+		}
+		atomic_fetch_sub(&hybridActiveTasks, 1);
+	}
+	return NULL;
+}
+
+/**
+ * receive and act on one incoming scheduler message on the main thread
+ * @param status: the probed status of the message to receive
+ */
+void hybridHandleMessage(MPI_Status* status) {
+	int bytes;
+	MPI_Get_count(status, MPI_BYTE, &bytes);
+	int source = status->MPI_SOURCE;
+	hybridDeque* mainDeque = &hybridDeques[hybridThreads];
+	switch (status->MPI_TAG) {
+		case STEAL_TAG_REQUEST: {
+			MPI_Recv(NULL, 0, MPI_BYTE, source, STEAL_TAG_REQUEST, stealComm, MPI_STATUS_IGNORE);
+			STAT_RECEIVED(0);
+			if (stealTerminated)
+				break;
+			// give away the shallowest task we can steal from our own workers
+			unsigned long long randState = stealRand();
+			hybridTask* task = hybridStealAny(-1, &randState);
+			if (task == NULL) {
+				stealIssend(NULL, 0, source, STEAL_TAG_NONE);
+				break;
+			}
+			stealIssend(task->possibleValues, boardSize*boardSize*sizeof(candidateSet), source, STEAL_TAG_WORK);
+			free(task);
+			atomic_fetch_sub(&hybridActiveTasks, 1);
+			++stealMessageCount;
+			++stealWorkGiven;
+			break;
+		}
+		case STEAL_TAG_WORK: {
+			hybridTask* task = malloc(sizeof(hybridTask) + bytes);
+			MPI_Recv(task->possibleValues, bytes, MPI_BYTE, source, STEAL_TAG_WORK, stealComm, MPI_STATUS_IGNORE);
+			STAT_RECEIVED(bytes);
+			atomic_fetch_add(&hybridActiveTasks, 1);
+			if (!hybridDequePush(mainDeque, task)) {
+				// the main deque only ever holds work from other ranks, one task per request, so this can't happen
+				fprintf(stderr,"rank %d: main deque overflow\n", rank);
+				MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+			}
+			hybridWake(false);
+			--stealMessageCount;
+			stealBlack = true;
+			stealRequestOutstanding = false;
+			++stealWorkReceived;
+			break;
+		}
+		default:
+			// no-work replies, tokens and announcements are handled the same as in the single-threaded scheduler
+			stealHandleMessage(NULL, status);
+	}
+}
+
+/**
+ * solve the specified board using a pool of hybridThreads worker threads per rank, with ranks stealing tasks from one another.
+ * rank 0 starts with the full search tree as a single task.
+ * @param iBoard: 2d array containing the board data
+ * @returns whether this rank found a solution (true) or not (false)
+ */
+bool hybridCPSolver(int** iBoard) {
+	// without MPI_THREAD_FUNNELED no other thread may run beside the main thread, so the main thread runs the one worker's search
+	// itself, which is the single-threaded work-stealing solver
+	if (!hybridThreadsAllowed)
+		return parallelCPSolver(iBoard);
+	if (hybridThreads <= 0)
+		hybridThreads = sysconf(_SC_NPROCESSORS_ONLN) > 0 ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+	int numCells = boardSize*boardSize;
+	hybridWorkers = calloc(hybridThreads, sizeof(hybridWorker));
+	hybridDeques = calloc(hybridThreads+1, sizeof(hybridDeque));
+	hybridSolution = malloc(numCells*sizeof(candidateSet));
+	atomic_store(&hybridActiveTasks, 0);
+	atomic_store(&hybridStop, false);
+	atomic_store(&hybridSolved, false);
+	STAT_MAX(rankStats, workers, hybridThreads);
+	if (numRanks > 1)
+		stealInit();
+
+	// rank 0 seeds its main deque with the full board
+	if (rank == 0) {
+		hybridTask* root = malloc(sizeof(hybridTask) + numCells*sizeof(candidateSet));
+		initPossibleValues(iBoard, root->possibleValues);
+		atomic_store(&hybridActiveTasks, 1);
+		hybridDequePush(&hybridDeques[hybridThreads], root);
+	}
+
+	for (int i = 0; i < hybridThreads; ++i) {
+		hybridWorker* worker = &hybridWorkers[i];
+		worker->id = i;
+		worker->deque = &hybridDeques[i];
+		worker->randState = 0x9E3779B97F4A7C15ULL * ((unsigned long long)rank*hybridThreads + i + 1);
+		cpEngineInit(&worker->engine, iBoard);
+		pthread_create(&worker->thread, NULL, hybridWorkerMain, worker);
+	}
+
+	// the main thread moves work between ranks until a solution is found somewhere or every rank runs out of work
+	while (true) {
+		if (atomic_load(&hybridSolved)) {
+			if (numRanks > 1)
+				stealAnnounceDone(true);
+			break;
+		}
+		if (numRanks == 1) {
+			if (atomic_load(&hybridActiveTasks) == 0)
+				break;
+			sched_yield();
+			continue;
+		}
+		int flag;
+		MPI_Status status;
+		MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, stealComm, &flag, &status);
+		if (flag)
+			hybridHandleMessage(&status);
+		if (stealTerminated)
+			break;
+		// with no tasks queued or running anywhere on this rank, we're idle as far as the other ranks are concerned
+		if (atomic_load(&hybridActiveTasks) == 0)
+			stealIdleStep();
+		else
+			stealProgressSends();
+		if (!flag)
+			sched_yield();
+	}
+	atomic_store(&hybridStop, true);
+	hybridWake(true);
+
+	// collect the workers, then settle any late messages
+	long long tasksRun = 0;
+	for (int i = 0; i < hybridThreads; ++i) {
+		pthread_join(hybridWorkers[i].thread, NULL);
+		tasksRun += hybridWorkers[i].tasksRun;
+		cpEngineFree(&hybridWorkers[i].engine);
+		while (hybridWorkers[i].freeTasks != NULL) {
+			hybridTask* next = hybridWorkers[i].freeTasks->next;
+			free(hybridWorkers[i].freeTasks);
+			hybridWorkers[i].freeTasks = next;
+		}
+	}
+	for (int i = 0; i <= hybridThreads; ++i) {
+		hybridTask* task;
+		while ((task = hybridDequeSteal(&hybridDeques[i])) != NULL)
+			free(task);
+	}
+	if (numRanks > 1)
+		stealFinish();
+
+	bool solved = atomic_load(&hybridSolved);
+	if (solved)
+		copyPossibilitiesToBoard(iBoard, hybridSolution);
+	free(hybridSolution);
+	free(hybridDeques);
+	free(hybridWorkers);
+	return solved;
+}
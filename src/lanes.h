@@ -0,0 +1,159 @@
+// multi-puzzle lane solver for batches of easy puzzles: LANE_COUNT puzzles are held side by side in structure-of-arrays layout,
+// one candidate set per cell per lane, and naked and hidden singles are applied to every lane at once. the lane loops are plain C
+// that the compiler vectorizes; on x86 the propagation routine is compiled for AVX-512, AVX2 and baseline x86-64, and the loader
+// picks the best copy the processor supports, while other targets (such as BG/Q) build the plain loops once. lanes that singles
+// can't finish are handed to a scalar solver one at a time.
+
+#define LANE_COUNT 16  // puzzles propagated together: one 512-bit vector, or two 256-bit vectors, of 32-bit candidate sets
+#define LANE_MAX_BOARD_SIZE 25  // largest board whose candidate sets fit in a lane
+#define LANE_MASK_FALLBACK_FRACTION 3  // lanes left with at most 1/this of their cells open fall back to the mask solver, others to CP
+
+// candidate set of one cell in one lane; bit v-1 is set while value v remains possible
+typedef uint32_t laneSet;
+
+bool batchLanes = true;  // the batch solver propagates puzzles in lanes before falling back to a scalar solver
+
+/**
+ * apply one round of naked and hidden singles to every unit in every lane
+ * @param n: the board size, a compile-time constant in each specialized copy
+ * @param k: the region size (unused; present to match the other sized kernels)
+ * @param cand: the candidate sets, LANE_COUNT per cell, cell-major
+ * @param changed: OR'd with the candidate bits each lane lost
+ * @param failed: set nonzero in each lane that reached a contradiction
+ */
+SIZED_KERNEL void lanePropagateKernel(const int n, const int k, laneSet* cand, laneSet* changed, laneSet* failed) {
+	const laneSet all = (laneSet)candAllSized(n);
+	for (int unit = 0; unit < 3*n; ++unit) {
+		uint16_t* unitCells = &units[unit*n];
+		// find the values placed in the unit (and placed twice), and the values possible in at least one and in more than one cell
+		laneSet placed[LANE_COUNT] = {0}, duplicated[LANE_COUNT] = {0}, once[LANE_COUNT] = {0}, twice[LANE_COUNT] = {0};
+		for (int i = 0; i < n; ++i) {
+			laneSet* cell = &cand[unitCells[i]*LANE_COUNT];
+			for (int lane = 0; lane < LANE_COUNT; ++lane) {
+				laneSet x = cell[lane], single = (x & (x-1)) == 0 ? x : 0;
+				duplicated[lane] |= placed[lane] & single;
+				placed[lane] |= single;
+				twice[lane] |= once[lane] & x;
+				once[lane] |= x;
+			}
+		}
+		for (int lane = 0; lane < LANE_COUNT; ++lane)
+			failed[lane] |= duplicated[lane] | (all & ~once[lane]);
+
+		// singletons stay; a cell holding a value found nowhere else in the unit takes it; every other cell loses the placed values
+		for (int i = 0; i < n; ++i) {
+			laneSet* cell = &cand[unitCells[i]*LANE_COUNT];
+			for (int lane = 0; lane < LANE_COUNT; ++lane) {
+				laneSet x = cell[lane], hidden = x & once[lane] & ~twice[lane];
+				laneSet y = (x & (x-1)) == 0 ? x : hidden != 0 ? hidden : x & ~placed[lane];
+				failed[lane] |= (y == 0) | ((hidden & (hidden-1)) != 0);
+				changed[lane] |= x ^ y;
+				cell[lane] = y;
+			}
+		}
+	}
+}
+
+// function multiversioning and the CPU probe are x86 only
+#if defined(__x86_64__) || defined(__i386__)
+#define LANE_TARGET_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define LANE_TARGET_CLONES
+#endif
+
+/**
+ * run singles to a fixed point in every lane. on x86, compiled once per instruction set, with the best copy chosen when the
+ * program loads.
+ * @param cand: the candidate sets, LANE_COUNT per cell, cell-major
+ * @param failed: set nonzero in each lane that reached a contradiction
+ */
+LANE_TARGET_CLONES
+void lanePropagate(laneSet* cand, laneSet* failed) {
+	bool anyChanged = true;
+	while (anyChanged) {
+		laneSet changed[LANE_COUNT] = {0};
+		switch (boardSize) {
+			case 9: lanePropagateKernel(9, 3, cand, changed, failed); break;
+			case 16: lanePropagateKernel(16, 4, cand, changed, failed); break;
+			case 25: lanePropagateKernel(25, 5, cand, changed, failed); break;
+			default: lanePropagateKernel(boardSize, regionSize, cand, changed, failed);
+		}
+		// failed lanes still shrink monotonically, so they settle too, but there's no need to wait for them
+		laneSet anyLane = 0;
+		for (int lane = 0; lane < LANE_COUNT; ++lane)
+			anyLane |= failed[lane] ? 0 : changed[lane];
+		anyChanged = anyLane != 0;
+	}
+}
+
+/**
+ * get the instruction set the lane solver runs with on this processor
+ * @returns: the name of the widest vector extension lanePropagate was compiled for that the processor supports
+ */
+const char* laneInstructionSet() {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) return "avx512f";
+	if (__builtin_cpu_supports("avx2")) return "avx2";
+#endif
+	return "scalar";
+}
+
+/**
+ * solve a run of puzzles LANE_COUNT at a time: singles in lanes, then a scalar solver for any lane that needs to branch.
+ * puzzles solved in lanes are each timed as an equal share of their group's propagation time.
+ * @param puzzles: the puzzles' cell values, one byte per cell, stored back to back
+ * @param numPuzzles: the number of puzzles
+ * @param solutions: filled with each puzzle's resulting cell values, one byte per cell; a puzzle without a solution is left partly filled
+ * @param solutionStride: the number of bytes from the start of one solution to the start of the next
+ * @param solveTimes: filled with each puzzle's solve time in seconds
+ */
+void laneSolvePuzzles(const unsigned char* puzzles, int numPuzzles, unsigned char* solutions, size_t solutionStride, double* solveTimes) {
+	int numCells = boardSize*boardSize;
+	laneSet* cand = malloc((size_t)numCells*LANE_COUNT*sizeof(laneSet));
+	laneSet all = (laneSet)candAll();
+	for (int first = 0; first < numPuzzles; first += LANE_COUNT) {
+		int numLanes = numPuzzles - first < LANE_COUNT ? numPuzzles - first : LANE_COUNT;
+		double startTime = MPI_Wtime();
+
+		// load each puzzle into its lane; unused lanes hold empty boards, which singles leave alone
+		for (int cell = 0; cell < numCells; ++cell) {
+			for (int lane = 0; lane < LANE_COUNT; ++lane) {
+				int val = lane < numLanes ? puzzles[(size_t)(first + lane)*numCells + cell] : 0;
+				cand[cell*LANE_COUNT + lane] = val == 0 ? all : (laneSet)candBit(val);
+			}
+		}
+		laneSet failed[LANE_COUNT] = {0};
+		lanePropagate(cand, failed);
+		double laneTime = (MPI_Wtime() - startTime) / numLanes;
+
+		for (int lane = 0; lane < numLanes; ++lane) {
+			unsigned char* solution = &solutions[(first + lane)*solutionStride];
+			int numOpen = 0;
+			for (int cell = 0; cell < numCells; ++cell) {
+				laneSet x = cand[cell*LANE_COUNT + lane];
+				bool single = x != 0 && (x & (x-1)) == 0;
+				numOpen += !single;
+				solution[cell] = single ? candLowest(x) : 0;
+			}
+			solveTimes[first + lane] = laneTime;
+			// a contradiction means there's no solution, so there's nothing to search for; the caller finds the board unsolved
+			if (failed[lane] || numOpen == 0)
+				continue;
+
+			// branch from the lane's singles. the mask solver has no setup cost, so it wins when singles left little to fill in;
+			// otherwise CP's stronger propagation prunes more than its setup costs
+			double searchStart = MPI_Wtime();
+			for (int cell = 0; cell < numCells; ++cell)
+				board[cell/boardSize][cell%boardSize] = solution[cell];
+			if (numOpen <= numCells/LANE_MASK_FALLBACK_FRACTION)
+				serialMaskSolver(board);
+			else
+				serialCPSolver(board);
+			for (int cell = 0; cell < numCells; ++cell)
+				solution[cell] = board[cell/boardSize][cell%boardSize];
+			solveTimes[first + lane] += MPI_Wtime() - searchStart;
+		}
+	}
+	free(cand);
+}
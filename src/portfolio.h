@@ -0,0 +1,71 @@
+// portfolio solving: hard puzzles differ wildly in which search strategy suits them, so each rank runs the same board with a
+// different configuration (branching cell order, value order, propagation level, or engine) and the first rank to finish
+// cancels the rest. wins are tallied per configuration so the defaults can be tuned.
+
+// one search strategy in the portfolio
+typedef struct {
+	const char* name;
+	bool (*solve)(int** iBoard);  // a serial solver that stops when cancelRequested says so
+	int cellOrder;  // the CP_CELLS_* order (CP engine only)
+	int valueOrder;  // the CP_VALUES_* order (CP engine only)
+	int level;  // the CP_LEVEL_* propagation level (CP engine only)
+} portfolioConfig;
+
+// rank r runs configuration r % PORTFOLIO_NUM_CONFIGS; the first is the serial CP solver's default strategy.
+// ranks beyond the list repeat it, and the random configurations still differ, as each rank has its own random stream.
+portfolioConfig portfolioConfigs[] = {
+	{"cp-mrv-ascending-subsets", serialCPSolver, CP_CELLS_MRV, CP_VALUES_ASCENDING, CP_LEVEL_SUBSETS},
+	{"dlx", serialDLXSolver, CP_CELLS_MRV, CP_VALUES_ASCENDING, CP_LEVEL_SUBSETS},
+	{"cp-mrv-random-subsets", serialCPSolver, CP_CELLS_MRV, CP_VALUES_RANDOM, CP_LEVEL_SUBSETS},
+	{"cp-degree-leastconstraining-subsets", serialCPSolver, CP_CELLS_MRV_DEGREE, CP_VALUES_LEAST_CONSTRAINING, CP_LEVEL_SUBSETS},
+	{"cp-mrv-random-singles", serialCPSolver, CP_CELLS_MRV, CP_VALUES_RANDOM, CP_LEVEL_SINGLES},
+	{"cp-degree-ascending-fish", serialCPSolver, CP_CELLS_MRV_DEGREE, CP_VALUES_ASCENDING, CP_LEVEL_FISH},
+	{"cp-mrv-leastconstraining-intersections", serialCPSolver, CP_CELLS_MRV, CP_VALUES_LEAST_CONSTRAINING, CP_LEVEL_INTERSECTIONS},
+	{"cp-degree-random-subsets", serialCPSolver, CP_CELLS_MRV_DEGREE, CP_VALUES_RANDOM, CP_LEVEL_SUBSETS},
+};
+#define PORTFOLIO_NUM_CONFIGS ((int)(sizeof(portfolioConfigs) / sizeof(portfolioConfig)))
+
+long long portfolioWins[PORTFOLIO_NUM_CONFIGS];  // boards solved first by each configuration, as seen by every rank
+
+/**
+ * solve the specified board with a different strategy on each rank; all ranks must call this together. outside of a cancellable
+ * search, the solver opens its own, so that the first rank to finish stops the rest and every rank learns which strategy won.
+ * @param iBoard: 2d array containing the board data
+ * @returns: whether this rank found a solution (true) or not (false)
+ */
+bool portfolioSolver(int** iBoard) {
+	portfolioConfig* config = &portfolioConfigs[rank % PORTFOLIO_NUM_CONFIGS];
+	int savedCellOrder = cpCellOrder, savedValueOrder = cpValueOrder, savedLevel = cpLevel;
+	cpCellOrder = config->cellOrder;
+	cpValueOrder = config->valueOrder;
+	cpLevel = config->level;
+
+	bool ownSearch = numRanks > 1 && !cancelActive;
+	if (ownSearch)
+		cancelInit();
+	bool solved = config->solve(iBoard);
+	cpCellOrder = savedCellOrder;
+	cpValueOrder = savedValueOrder;
+	cpLevel = savedLevel;
+
+	if (ownSearch) {
+		solved = solved && cancelAnnounce();
+		int winner = cancelFinish();
+		if (winner >= 0)
+			++portfolioWins[winner % PORTFOLIO_NUM_CONFIGS];
+	}
+	else if (solved && numRanks == 1)
+		++portfolioWins[0];
+	return solved;
+}
+
+/**
+ * print how many boards each portfolio configuration has solved first, from rank 0
+ */
+void reportPortfolioWins() {
+	if (rank != 0)
+		return;
+	for (int i = 0; i < PORTFOLIO_NUM_CONFIGS && i < numRanks; ++i)
+		printf("portfolio %s: won %lld\n", portfolioConfigs[i].name, portfolioWins[i]);
+	fflush(stdout);
+}
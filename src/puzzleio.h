@@ -0,0 +1,310 @@
+// puzzle file formats: one-line text (one character per cell, '.' or '0' for blanks, one puzzle per line) and packed binary
+// (a header giving the board size and puzzle count, then each puzzle's cells packed into the fewest bits that hold 0..boardSize).
+// files are read through a memory map, so batch runs parse puzzles straight out of the page cache with no per-cell stdio calls.
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// external references to functions defined in the generator
+int cellValueFromChar(char c);
+char cellValueToChar(int val);
+
+#define PUZZLE_FORMAT_TEXT 0
+#define PUZZLE_FORMAT_BINARY 1
+#define PUZZLE_BINARY_MAGIC "SDKB"
+#define PUZZLE_BINARY_VERSION 1
+
+// header at the front of every binary puzzle file, followed by count records of puzzleRecordBytes each
+typedef struct {
+	char magic[4];  // PUZZLE_BINARY_MAGIC
+	uint8_t version;
+	uint8_t boardSize;
+	uint8_t bitsPerCell;
+	uint8_t reserved;
+	uint64_t count;  // number of puzzle records in the file
+} puzzleBinaryHeader;
+
+// a puzzle file opened for reading
+typedef struct {
+	const unsigned char* data;  // the mapped file
+	size_t size;
+	size_t offset;  // position of the next unread puzzle
+	int format;
+	uint64_t count;  // binary files only: number of records
+	uint64_t index;  // binary files only: number of records read so far
+	signed char charValues[256];  // text files only: cell value for each character, or -1
+	bool quiet;  // skip malformed puzzles without a warning, such as while probing whether a file is a puzzle file at all
+} puzzleReader;
+
+// a puzzle file opened for writing
+typedef struct {
+	FILE* fp;
+	int format;
+	uint64_t count;  // number of puzzles written so far
+	unsigned char* record;  // one encoded record
+} puzzleWriter;
+
+/**
+ * get the number of bits needed to store any cell value (0..boardSize) in a binary record
+ * @returns: 4 for 9x9 boards, 5 for 16x16 and 25x25 boards, and so on
+ */
+int puzzleBitsPerCell() {
+	int bits = 1;
+	while ((1 << bits) <= boardSize)
+		++bits;
+	return bits;
+}
+
+/**
+ * get the size of one encoded puzzle record
+ * @param format: PUZZLE_FORMAT_TEXT or PUZZLE_FORMAT_BINARY
+ * @returns: the number of bytes per puzzle, including the newline of a text record
+ */
+size_t puzzleRecordBytes(int format) {
+	int numCells = boardSize*boardSize;
+	return format == PUZZLE_FORMAT_BINARY ? (numCells*puzzleBitsPerCell() + 7) / 8 : numCells + 1;
+}
+
+/**
+ * get the header that begins a binary puzzle file
+ * @param count: the number of puzzles the file holds
+ * @returns: the filled in header
+ */
+puzzleBinaryHeader puzzleMakeHeader(uint64_t count) {
+	puzzleBinaryHeader header;
+	memcpy(header.magic, PUZZLE_BINARY_MAGIC, 4);
+	header.version = PUZZLE_BINARY_VERSION;
+	header.boardSize = boardSize;
+	header.bitsPerCell = puzzleBitsPerCell();
+	header.reserved = 0;
+	header.count = count;
+	return header;
+}
+
+/**
+ * encode a puzzle as a single record
+ * @param format: PUZZLE_FORMAT_TEXT or PUZZLE_FORMAT_BINARY
+ * @param cells: the puzzle's cell values, one byte per cell
+ * @param record: the buffer to fill, puzzleRecordBytes(format) long
+ */
+void puzzleEncode(int format, const unsigned char* cells, unsigned char* record) {
+	int numCells = boardSize*boardSize;
+	if (format == PUZZLE_FORMAT_TEXT) {
+		for (int i = 0; i < numCells; ++i)
+			record[i] = cellValueToChar(cells[i]);
+		record[numCells] = '\n';
+		return;
+	}
+	// binary: cells are packed least significant bits first, in cell order
+	int bits = puzzleBitsPerCell();
+	memset(record, 0, puzzleRecordBytes(format));
+	uint32_t acc = 0;
+	int accBits = 0;
+	for (int i = 0; i < numCells; ++i) {
+		acc |= (uint32_t)cells[i] << accBits;
+		accBits += bits;
+		while (accBits >= 8) {
+			*record++ = acc & 0xFF;
+			acc >>= 8;
+			accBits -= 8;
+		}
+	}
+	if (accBits > 0)
+		*record = acc;
+}
+
+/**
+ * decode a binary record
+ * @param record: the packed record
+ * @param bits: the number of bits per cell
+ * @param cells: filled with the puzzle's cell values, one byte per cell
+ * @returns: whether every cell value was valid for the current board size (true) or not (false)
+ */
+bool puzzleDecodeBinary(const unsigned char* record, int bits, unsigned char* cells) {
+	int numCells = boardSize*boardSize;
+	uint32_t acc = 0, mask = (1u << bits) - 1;
+	int accBits = 0;
+	bool valid = true;
+	for (int i = 0; i < numCells; ++i) {
+		while (accBits < bits) {
+			acc |= (uint32_t)*record++ << accBits;
+			accBits += 8;
+		}
+		cells[i] = acc & mask;
+		valid &= cells[i] <= boardSize;
+		acc >>= bits;
+		accBits -= bits;
+	}
+	return valid;
+}
+
+/**
+ * open a puzzle file for reading, detecting its format from its first bytes
+ * @param reader: the reader to initialize
+ * @param fName: the name of the file to open
+ * @returns: whether the file was opened (true) or couldn't be opened or doesn't match the current board size (false)
+ */
+bool puzzleReaderOpen(puzzleReader* reader, char fName[]) {
+	int fd = open(fName, O_RDONLY);
+	if (fd == -1) {
+		fprintf(stderr,"Unable to locate file %s\n",fName);
+		return false;
+	}
+	struct stat st;
+	fstat(fd, &st);
+	reader->size = st.st_size;
+	reader->offset = reader->index = reader->count = 0;
+	reader->data = NULL;
+	reader->quiet = false;
+	if (reader->size > 0) {
+		void* data = mmap(NULL, reader->size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			fprintf(stderr,"Unable to map file %s\n",fName);
+			close(fd);
+			return false;
+		}
+		madvise(data, reader->size, MADV_SEQUENTIAL);
+		reader->data = data;
+	}
+	close(fd);
+
+	reader->format = PUZZLE_FORMAT_TEXT;
+	if (reader->size >= sizeof(puzzleBinaryHeader) && memcmp(reader->data, PUZZLE_BINARY_MAGIC, 4) == 0) {
+		puzzleBinaryHeader header;
+		memcpy(&header, reader->data, sizeof(header));
+		if (header.boardSize != boardSize || header.bitsPerCell != puzzleBitsPerCell()) {
+			fprintf(stderr,"%s holds %dx%d boards, but the board size is %d\n",fName, header.boardSize, header.boardSize, boardSize);
+			munmap((void*)reader->data, reader->size);
+			return false;
+		}
+		reader->format = PUZZLE_FORMAT_BINARY;
+		reader->count = header.count;
+		reader->offset = sizeof(puzzleBinaryHeader);
+	}
+	for (int c = 0; c < 256; ++c)
+		reader->charValues[c] = cellValueFromChar(c);
+	return true;
+}
+
+/**
+ * read the next puzzle from a puzzle file. text lines that don't begin with a complete board are skipped (with a warning, unless
+ * they're blank, begin with '#', or the reader is quiet); anything after the board on a line, such as a solve time, is ignored.
+ * @param reader: the reader to read from
+ * @param cells: filled with the puzzle's cell values, one byte per cell
+ * @returns: whether a puzzle was read (true) or the file is exhausted (false)
+ */
+bool puzzleReaderNext(puzzleReader* reader, unsigned char* cells) {
+	int numCells = boardSize*boardSize;
+	if (reader->format == PUZZLE_FORMAT_BINARY) {
+		size_t recordBytes = puzzleRecordBytes(PUZZLE_FORMAT_BINARY);
+		while (reader->index < reader->count && reader->offset + recordBytes <= reader->size) {
+			const unsigned char* record = reader->data + reader->offset;
+			reader->offset += recordBytes;
+			++reader->index;
+			if (puzzleDecodeBinary(record, puzzleBitsPerCell(), cells))
+				return true;
+			if (!reader->quiet)
+				fprintf(stderr,"Skipping malformed puzzle record %llu\n", (unsigned long long)reader->index-1);
+		}
+		return false;
+	}
+
+	while (reader->offset < reader->size) {
+		const unsigned char* line = reader->data + reader->offset;
+		size_t remaining = reader->size - reader->offset;
+		const unsigned char* end = memchr(line, '\n', remaining);
+		size_t lineLen = end != NULL ? (size_t)(end - line) : remaining;
+		reader->offset += lineLen + (end != NULL);
+
+		bool valid = lineLen >= numCells;
+		for (int i = 0; valid && i < numCells; ++i) {
+			signed char val = reader->charValues[line[i]];
+			valid = val >= 0;
+			cells[i] = val;
+		}
+		if (valid)
+			return true;
+		if (!reader->quiet && lineLen > 0 && line[0] != '#' && line[0] != '\r')
+			fprintf(stderr,"Skipping malformed puzzle line: %.*s\n", (int)lineLen, line);
+	}
+	return false;
+}
+
+/**
+ * close a puzzle file opened for reading
+ * @param reader: the reader to close
+ */
+void puzzleReaderClose(puzzleReader* reader) {
+	if (reader->data != NULL)
+		munmap((void*)reader->data, reader->size);
+	reader->data = NULL;
+}
+
+/**
+ * open a puzzle file for writing, truncating it
+ * @param writer: the writer to initialize
+ * @param fName: the name of the file to open
+ * @param format: PUZZLE_FORMAT_TEXT or PUZZLE_FORMAT_BINARY
+ * @returns: whether the file was opened (true) or not (false)
+ */
+bool puzzleWriterOpen(puzzleWriter* writer, char fName[], int format) {
+	if ((writer->fp = fopen(fName, "wb")) == NULL) {
+		fprintf(stderr,"Unable to open file %s for writing\n",fName);
+		return false;
+	}
+	setvbuf(writer->fp, NULL, _IOFBF, 1 << 20);
+	writer->format = format;
+	writer->count = 0;
+	writer->record = malloc(puzzleRecordBytes(format));
+	// the binary header's count is filled in on close
+	if (format == PUZZLE_FORMAT_BINARY) {
+		puzzleBinaryHeader header = puzzleMakeHeader(0);
+		fwrite(&header, sizeof(header), 1, writer->fp);
+	}
+	return true;
+}
+
+/**
+ * write one puzzle (or solution) to a puzzle file
+ * @param writer: the writer to write to
+ * @param cells: the puzzle's cell values, one byte per cell
+ * @param note: text to append to the puzzle's line in a text file, such as a solve time (NULL for none; binary files drop it)
+ */
+void puzzleWriterPut(puzzleWriter* writer, const unsigned char* cells, const char* note) {
+	puzzleEncode(writer->format, cells, writer->record);
+	size_t recordBytes = puzzleRecordBytes(writer->format);
+	if (writer->format == PUZZLE_FORMAT_TEXT && note != NULL) {
+		fwrite(writer->record, recordBytes-1, 1, writer->fp);
+		fputs(note, writer->fp);
+		fputc('\n', writer->fp);
+	}
+	else
+		fwrite(writer->record, recordBytes, 1, writer->fp);
+	++writer->count;
+}
+
+/**
+ * finish and close a puzzle file opened for writing
+ * @param writer: the writer to close
+ */
+void puzzleWriterClose(puzzleWriter* writer) {
+	if (writer->format == PUZZLE_FORMAT_BINARY) {
+		puzzleBinaryHeader header = puzzleMakeHeader(writer->count);
+		fseek(writer->fp, 0, SEEK_SET);
+		fwrite(&header, sizeof(header), 1, writer->fp);
+	}
+	fclose(writer->fp);
+	free(writer->record);
+}
+
+/**
+ * parse a puzzle format name
+ * @param name: "text" or "binary"
+ * @returns: the matching format, or -1 if the name isn't recognized
+ */
+int puzzleFormatFromName(char name[]) {
+	if (strcmp(name, "text") == 0) return PUZZLE_FORMAT_TEXT;
+	if (strcmp(name, "binary") == 0) return PUZZLE_FORMAT_BINARY;
+	return -1;
+}
@@ -0,0 +1,97 @@
+// randomized restarts for the serial CP solver. a wrong early decision can trap a chronological search in a huge subtree, so
+// with restarts enabled each run of the search gives up after a node limit taken from the Luby sequence (unit, unit, 2*unit,
+// unit, unit, 2*unit, 4*unit, ...) and starts again from the root with fresh random tie-breaking between equally constrained
+// cells. nogoods, the short decision paths whose subtrees were fully refuted, carry over from one run to the next so that no
+// run repeats the work of an earlier one.
+
+#define NOGOOD_MAX_SIZE 8  // most decisions a nogood may hold
+#define NOGOOD_CAPACITY 16384  // most nogoods kept per solve; later ones are dropped
+
+long long cpRestartUnit = 0;  // nodes in the shortest run of a restarting search, or 0 to search without restarts
+int cpNogoodSize = 3;  // decisions in the longest nogood recorded, up to NOGOOD_MAX_SIZE, or 0 to record none
+
+// state of the current restarting search
+long long restartNodeLimit = 0;  // node count at which the current run gives up, or 0 outside of a restarting search
+bool restartAborted;  // the current run hit its node limit, so nothing below the abort point was refuted
+int restartDepth;  // decisions on the current search path
+int restartPath[NOGOOD_MAX_SIZE];  // the first decisions on the current search path, as literals (cell*boardSize + value-1)
+
+// recorded nogoods, each indexed under every literal it holds so that a decision only checks the nogoods it could complete
+int nogoodLits[NOGOOD_CAPACITY][NOGOOD_MAX_SIZE];
+int nogoodSizes[NOGOOD_CAPACITY];
+int numNogoods;
+int* nogoodFirstEntry;  // per literal, the first index entry holding it, or -1
+int nogoodEntryNogood[NOGOOD_CAPACITY*NOGOOD_MAX_SIZE];  // per index entry, the nogood it points to
+int nogoodEntryNext[NOGOOD_CAPACITY*NOGOOD_MAX_SIZE];  // per index entry, the next entry for the same literal, or -1
+int numNogoodEntries;
+
+// restart counters, which are always kept
+long long totalRestarts = 0;
+long long totalNogoods = 0;
+long long totalNogoodPrunes = 0;
+
+/**
+ * get a term of the Luby sequence 1, 1, 2, 1, 1, 2, 4, 1, 1, 2, 1, 1, 2, 4, 8, ..., which is within a constant factor of the
+ * best possible restart schedule when nothing is known about the distribution of run times
+ * @param i: the index of the term, starting from 1
+ * @returns: the term
+ */
+long long lubyTerm(long long i) {
+	int k = 1;
+	while ((1LL << k) - 1 < i)
+		++k;
+	if ((1LL << k) - 1 == i)
+		return 1LL << (k-1);
+	return lubyTerm(i - (1LL << (k-1)) + 1);
+}
+
+/**
+ * forget every recorded nogood, such as before a new board's search; nogoods only hold for the board they were learned on
+ */
+void nogoodReset() {
+	int numLits = boardSize*boardSize*boardSize;
+	nogoodFirstEntry = realloc(nogoodFirstEntry, numLits*sizeof(int));
+	for (int lit = 0; lit < numLits; ++lit)
+		nogoodFirstEntry[lit] = -1;
+	numNogoods = 0;
+	numNogoodEntries = 0;
+}
+
+/**
+ * record that a set of decisions leads to no solution
+ * @param lits: the decisions, as literals (cell*boardSize + value-1)
+ * @param size: the number of decisions
+ */
+void nogoodRecord(int* lits, int size) {
+	if (numNogoods == NOGOOD_CAPACITY)
+		return;
+	for (int i = 0; i < size; ++i) {
+		nogoodLits[numNogoods][i] = lits[i];
+		nogoodEntryNogood[numNogoodEntries] = numNogoods;
+		nogoodEntryNext[numNogoodEntries] = nogoodFirstEntry[lits[i]];
+		nogoodFirstEntry[lits[i]] = numNogoodEntries++;
+	}
+	nogoodSizes[numNogoods++] = size;
+	++totalNogoods;
+}
+
+/**
+ * determine whether making a decision would complete a recorded nogood, i.e. whether some nogood holding the decision has every
+ * other decision already in force (chosen or implied by propagation) in the current state
+ * @param possibleValues: the full possibleValues array
+ * @param lit: the decision, as a literal (cell*boardSize + value-1)
+ * @returns: whether the decision leads to no solution (true) or isn't known to (false)
+ */
+bool nogoodViolated(candidateSet* possibleValues, int lit) {
+	for (int entry = nogoodFirstEntry[lit]; entry != -1; entry = nogoodEntryNext[entry]) {
+		int nogood = nogoodEntryNogood[entry];
+		bool holds = true;
+		for (int i = 0; i < nogoodSizes[nogood] && holds; ++i) {
+			int other = nogoodLits[nogood][i];
+			holds = other == lit || possibleValues[other/boardSize] == candBit(other%boardSize + 1);
+		}
+		if (holds)
+			return true;
+	}
+	return false;
+}
@@ -1,38 +1,128 @@
+#include <stdint.h>
+#include <string.h>
+
 // external references to variables and functions defined in the generator
-extern const int boardSize;  // size of both board dimensions
-extern const int removePercent;  // what percentage of cells to remove for non-evil puzzles
+extern int boardSize;  // size of both board dimensions
+extern int removePercent;  // what percentage of cells to remove for non-evil puzzles
 extern int regionSize;
 extern int** board;
-extern int**** peers;
+extern uint16_t* peers;
+extern uint16_t* units;
+extern uint16_t* cellUnits;
 extern int numRanks;
 extern int rank;
 extern int numPeers;
 bool boardIsSolved(int** iBoard);
 bool cellIsValid(int row, int col, int** iBoard);
 int boardIsFilled(int** iBoard);
-int ***alloc_3d_int(int x, int y, int z);
-void dealloc_3d_int(int x, int ***arr);
-const int maxBoards = 10000;  // statically allocated for performance purposes; please raise for large search space
-int numBoards = 0;
+uint64_t randNext();
+
+// size-specialized kernels are always inlined into a switch over the common board sizes, so that the board size,
+// region size and full candidate mask are compile-time constants in each copy; other sizes fall back to the runtime values
+#define SIZED_KERNEL static inline __attribute__((always_inline))
+#define DISPATCH_BOARD_SIZE(kernel, ...) \
+	switch (boardSize) { \
+		case 9: return kernel(9, 3, __VA_ARGS__); \
+		case 16: return kernel(16, 4, __VA_ARGS__); \
+		case 25: return kernel(25, 5, __VA_ARGS__); \
+		case 36: return kernel(36, 6, __VA_ARGS__); \
+		default: return kernel(boardSize, regionSize, __VA_ARGS__); \
+	}
+
+// a cell's candidate values stored as a bitmask in a single machine word; bit v-1 is set while value v remains possible
+typedef uint64_t candidateSet;
+
+/**
+ * get the candidate set containing only the specified value
+ * @param val: the value (1..boardSize) to convert
+ * @returns: a candidate set with only val's bit set
+ */
+static inline candidateSet candBit(int val) {
+	return (candidateSet)1 << (val-1);
+}
+
+/**
+ * get the candidate set containing every value 1..n
+ * @param n: the board size
+ * @returns: a candidate set with the lowest n bits set
+ */
+static inline candidateSet candAllSized(int n) {
+	return n >= 64 ? ~(candidateSet)0 : ((candidateSet)1 << n) - 1;
+}
+
+/**
+ * get the candidate set containing every value 1..boardSize
+ * @returns: a candidate set with the lowest boardSize bits set
+ */
+static inline candidateSet candAll() {
+	return candAllSized(boardSize);
+}
+
+/**
+ * count the number of values remaining in a candidate set
+ * @param cands: the candidate set to count
+ * @returns: the number of set bits in cands
+ */
+static inline int candCount(candidateSet cands) {
+	return __builtin_popcountll(cands);
+}
+
+/**
+ * determine whether a candidate set holds exactly one value
+ * @param cands: the candidate set to check
+ * @returns: whether cands contains a single value (true) or not (false)
+ */
+static inline bool candIsSingleton(candidateSet cands) {
+	return cands != 0 && (cands & (cands-1)) == 0;
+}
+
+/**
+ * get the lowest value remaining in a non-empty candidate set
+ * @param cands: the candidate set to examine
+ * @returns: the smallest value (1..boardSize) contained in cands
+ */
+static inline int candLowest(candidateSet cands) {
+	return __builtin_ctzll(cands) + 1;
+}
+
+// running totals of search work on this rank: brute force nodes as they are visited, CP work from every engine as it is freed
+long long totalNodes = 0;
+long long totalPropagationVisits = 0;
+long long totalSweepVisits = 0;
+
+#include "validate.h"
+#include "explored.h"
+#include "restarts.h"
+#include "stats.h"
+#include "cancel.h"
 
 /**
  * core recursive internal function for serial brute force solver; recursively fills in cell values
  * @param iBoard: 2d array containing the board data
+ * @param masks: the values placed in each row, column and region of iBoard
  * @returns: whether the current board is solved (true) or not (false)
  */
-bool serialBruteForceSolverInternal(int** iBoard) {
+bool serialBruteForceSolverInternal(int** iBoard, placementMasks* masks) {
+	++totalNodes;
+	// stop early if another rank has already found a solution
+	if (cancelRequested()) return false;
 	// get location of unfilled cell
 	int missingPos = boardIsFilled(iBoard);
-	// base case: board is full and solved
-	if (missingPos == -1 && boardIsSolved(iBoard)) return true;
+	// base case: board is full; every value was checked against the masks as it was placed, so the board is solved
+	if (missingPos == -1) return true;
 	int row = missingPos/boardSize, col = missingPos%boardSize;
+	STAT_ADD(rankStats, depth, 1);
+	STAT_MAX(rankStats, maxDepth, rankStats.depth);
 
 	// recursively iterate through possible values for unfilled cell
 	for (int i = 1; i <= boardSize; ++i) {
-		iBoard[row][col] = i;
-		if (cellIsValid(row,col,iBoard) && serialBruteForceSolverInternal(iBoard)) return true;
+		if (!placementAllowed(masks, row, col, i)) continue;
+		placementSet(masks, iBoard, row, col, i);
+		if (serialBruteForceSolverInternal(iBoard, masks)) return true;
+		placementClear(masks, iBoard, row, col);
 	}
-	iBoard[row][col] = 0;
+	STAT_ADD(rankStats, depth, -1);
+	STAT_ADD(rankStats, backtracks, 1);
 	return false;
 }
 
@@ -41,147 +131,167 @@ bool serialBruteForceSolverInternal(int** iBoard) {
  * @param iBoard: 2d array containing the board data
  */
 bool serialBruteForceSolver(int** iBoard) {
-	return serialBruteForceSolverInternal(iBoard);
+	placementMasks masks;
+	if (!placementMasksInit(&masks, iBoard))
+		return false;
+	STAT_TIMER_START(startTime);
+	bool solved = serialBruteForceSolverInternal(iBoard, &masks);
+	STAT_TIMER_ADD(rankStats, busyTime, startTime);
+	// a solved search returns with its branches still open, so the next search starts back at the root
+	STAT_ADD(rankStats, depth, -rankStats.depth);
+	return solved;
 }
 
+#define BRUTE_TASKS_PER_RANK 32  // frontier subproblems to generate per rank, so that uneven subtrees even out across ranks
+
 /**
- * core recursive internal function for parallel brute force solver; recursively fills in cell values.
+ * expand the brute force search tree breadth-first, one empty cell at a time in the order the serial solver fills them, until it
+ * holds enough open subproblems to share out. the expansion is deterministic, so every rank builds the same frontier without
+ * communicating.
  * @param iBoard: 2d array containing the board data
- * @param adjustedRank: a value propagated through the initial traversal yielding our current rank minus the number of ranks that have claimed a starting location
- * @param adjustedNumRanks: a value propagated through the initial traversal yielding the total number of ranks minus the number of ranks that have claimed a starting location
- * @param startRecursionLayer: counter which keeps track of the recursion layer at which the current rank begins solving, for debugging purposes
- * @returns: whether the current board is solved (true) or not (false)
+ * @param masks: the values placed in each row, column and region of iBoard
+ * @param emptyCells: the board's empty cells, in row-major order
+ * @param numEmpty: the number of empty cells
+ * @param target: the number of subproblems to stop at
+ * @param numTasks: filled with the number of subproblems returned
+ * @param depth: filled with the number of empty cells each subproblem fills in
+ * @returns: the subproblems, each the values of the first depth empty cells, which between them cover every solution exactly once
  */
-bool parallelBruteForceSolverInternal(int** iBoard, int adjustedRank, int adjustedNumRanks, int startRecursionLayer) {
-	// get location of unfilled cell
-	int missingPos = boardIsFilled(iBoard);
-
-	// base case: board is full and solved
-	if (missingPos == -1 && boardIsSolved(iBoard)) return true;
-	int row = missingPos/boardSize, col = missingPos%boardSize;
-
-	// first gather a list of all valid cells at this recursion level
-	int validCellValues[boardSize];
-	int numValidCellValues = 0;
-	for (int i = 1; i <= boardSize; ++i) {
-		iBoard[row][col] = i;
-		if (cellIsValid(row,col,iBoard))
-			validCellValues[numValidCellValues++] = i;
+unsigned char* bruteForceBuildFrontier(int** iBoard, placementMasks* masks, int* emptyCells, int numEmpty, int target, int* numTasks, int* depth) {
+	unsigned char* tasks = malloc(1);
+	*numTasks = 1;
+	*depth = 0;
+	while (*numTasks > 0 && *numTasks < target && *depth < numEmpty) {
+		// every legal value of the next empty cell extends each subproblem by one
+		int row = emptyCells[*depth]/boardSize, col = emptyCells[*depth]%boardSize;
+		unsigned char* next = malloc((size_t)*numTasks*boardSize*(*depth+1));
+		int numNext = 0;
+		for (int t = 0; t < *numTasks; ++t) {
+			unsigned char* prefix = &tasks[(size_t)t*(*depth)];
+			for (int d = 0; d < *depth; ++d)
+				placementSet(masks, iBoard, emptyCells[d]/boardSize, emptyCells[d]%boardSize, prefix[d]);
+			for (int val = 1; val <= boardSize; ++val) {
+				if (!placementAllowed(masks, row, col, val)) continue;
+				unsigned char* extended = &next[(size_t)numNext++*(*depth+1)];
+				memcpy(extended, prefix, *depth);
+				extended[*depth] = val;
+			}
+			for (int d = *depth-1; d >= 0; --d)
+				placementClear(masks, iBoard, emptyCells[d]/boardSize, emptyCells[d]%boardSize);
+		}
+		free(tasks);
+		tasks = next;
+		*numTasks = numNext;
+		++*depth;
 	}
+	return tasks;
+}
 
-	// nothing else for this rank to do if it hit a wall before starting
-	if (numValidCellValues == 0) {
-		return false;
-	}
+/**
+ * core function for the parallel brute force solver: build the frontier, then claim subproblems one at a time from rank 0's shared
+ * counter and search each with the serial solver, until one is solved, another rank finds a solution, or they run out
+ * @param iBoard: 2d array containing the board data
+ * @param masks: the values placed in each row, column and region of iBoard
+ * @returns: whether this rank solved the board (true) or not (false)
+ */
+bool parallelBruteForceSolverInternal(int** iBoard, placementMasks* masks) {
+	int numCells = boardSize*boardSize, numEmpty = 0;
+	int* emptyCells = malloc(numCells*sizeof(int));
+	for (int cell = 0; cell < numCells; ++cell)
+		if (iBoard[cell/boardSize][cell%boardSize] == 0) emptyCells[numEmpty++] = cell;
+	int numTasks, depth;
+	unsigned char* tasks = bruteForceBuildFrontier(iBoard, masks, emptyCells, numEmpty, BRUTE_TASKS_PER_RANK*numRanks, &numTasks, &depth);
 
-	// now attempt to evenly split up the initial tree traversal by rank
-	int cellStartIndex = -1;
-	if (numValidCellValues == adjustedNumRanks) {
-		// we have the same number of remaining ranks as valid cell values, so we can assign a 1:1 pairing
-		cellStartIndex = adjustedRank;
-	}
-	else if (numValidCellValues > adjustedNumRanks) {
-		// we have more valid cell values than remaining ranks, so divide the ranks up as evenly as possible
-		cellStartIndex = round(numValidCellValues/adjustedNumRanks)*adjustedRank;
-	}
-	else {
-		// we have more remaining ranks than valid cell values; stop here if our adjusted rank is low enough, otherwise iterate one level deeper
-		if (adjustedRank < numValidCellValues) {
-			cellStartIndex = adjustedRank;
-		}
-		else {
-			iBoard[row][col] = validCellValues[adjustedRank%numValidCellValues];
-			return parallelBruteForceSolverInternal(iBoard, adjustedRank-numValidCellValues, adjustedNumRanks-numValidCellValues, startRecursionLayer+1);
+	bool solved = false;
+	for (int i = 0; !solved && !cancelRequested(); ++i) {
+		int task = cancelActive ? cancelFetchAdd(CANCEL_SLOT_NEXT_TASK, 1) : i;
+		if (task >= numTasks)
+			break;
+		// only searching counts as busy, so building the frontier, claiming tasks and running out of them all show up as idle
+		STAT_TIMER_START(taskStart);
+		unsigned char* prefix = &tasks[(size_t)task*depth];
+		for (int d = 0; d < depth; ++d)
+			placementSet(masks, iBoard, emptyCells[d]/boardSize, emptyCells[d]%boardSize, prefix[d]);
+		// the serial solver fills the remaining cells in the same order, so a solved task leaves the full solution in iBoard
+		solved = serialBruteForceSolverInternal(iBoard, masks);
+		if (!solved) {
+			for (int d = depth-1; d >= 0; --d)
+				placementClear(masks, iBoard, emptyCells[d]/boardSize, emptyCells[d]%boardSize);
 		}
+		STAT_TIMER_ADD(rankStats, busyTime, taskStart);
 	}
-	printf("rank %d: cellStartIndex = %d numValidCellValues = %d startRecursionLayer = %d\n",rank,cellStartIndex,numValidCellValues, startRecursionLayer);
-
-	for (int i = cellStartIndex; i < numValidCellValues; ++i) {
-		// now that we've found our parallel initial traversal, we can switch to the serial solver
-		iBoard[row][col] = validCellValues[i];
-		if (serialBruteForceSolverInternal(iBoard))
-			return true;
-	}
-
-	iBoard[row][col] = 0;
-	return false;
+	free(tasks);
+	free(emptyCells);
+	return solved;
 }
 
 /**
- * solve the specified board in parallel using brute force to determine missing values.
+ * solve the specified board in parallel using brute force to determine missing values; all ranks must call this together.
+ * ranks pull subproblems from a frontier of about BRUTE_TASKS_PER_RANK per rank, so no rank is left idle by a shallow dead end.
+ * outside of a cancellable search, the solver opens its own so that the first rank to finish stops the rest.
  * @param iBoard: 2d array containing the board data
  * @returns whether this rank found a solution (true) or not (false)
  */
 bool parallelBruteForceSolver(int** iBoard) {
-	return parallelBruteForceSolverInternal(iBoard, rank, numRanks, 1);
+	placementMasks masks;
+	if (!placementMasksInit(&masks, iBoard))
+		return false;
+	bool ownSearch = numRanks > 1 && !cancelActive;
+	if (ownSearch)
+		cancelInit();
+	bool solved = parallelBruteForceSolverInternal(iBoard, &masks);
+	if (ownSearch) {
+		solved = solved && cancelAnnounce();
+		cancelFinish();
+	}
+	// a solved search returns with its branches still open, so the next search starts back at the root
+	STAT_ADD(rankStats, depth, -rankStats.depth);
+	return solved;
 }
 
+#include "backtrack.h"
+
 /**
- * remove the specified value from the possibleValues list for the cell at peerRow,peerCol
+ * determine whether or not any cells have more than one remaining possible value
+ * @param n: the board size, a compile-time constant in each specialized copy
+ * @param k: the region size (unused; present to match the other sized kernels)
  * @param possibleValues: the full possibleValues array
- * @param peerRow: the row of the cell from whom we wish to remove the possible value
- * @param peerCol: the column of the cell from whom we wish to remove the possible value
- * @param removeVal: the value we wish to remove
- * @returns: whether the value was found and removed (true) or not (false)
- */
-bool removePossibleValue(int*** possibleValues, int peerRow, int peerCol, int removeVal) {
-	for (int r = 0; r < boardSize && possibleValues[peerRow][peerCol][r] != 0; ++r) {
-		if (possibleValues[peerRow][peerCol][r] == removeVal) {
-			// value found; remove it and shift remaining values left
-			for (int k = r+1; k < boardSize && possibleValues[peerRow][peerCol][k-1] !=0; ++k)
-				possibleValues[peerRow][peerCol][k-1] = possibleValues[peerRow][peerCol][k];
-			possibleValues[peerRow][peerCol][boardSize-1] = 0;
-			return true;
-		}
+ * @returns whether at least one cell has more than one remaining possible value (true) or not (false)
+ */
+SIZED_KERNEL bool possibilitiesRemainKernel(const int n, const int k, candidateSet* possibleValues) {
+	for (int i = 0; i < n*n; ++i) {
+		if (!candIsSingleton(possibleValues[i]) && possibleValues[i] != 0) return true;
 	}
 	return false;
 }
 
 /**
- * determine whether or not any cells have more than one remaining possible value
+ * determine whether or not any cells have more than one remaining possible value, using the kernel specialized for the current board size
  * @param possibleValues: the full possibleValues array
  * @returns whether at least one cell has more than one remaining possible value (true) or not (false)
  */
-bool possibilitiesRemain(int*** possibleValues) {
-	for (int i = 0; i < boardSize; ++i) {
-		for (int r = 0; r < boardSize; ++r) {
-			if (possibleValues[i][r][1] != 0) return true;
-		}
-	}
-	return false;
+bool possibilitiesRemain(candidateSet* possibleValues) {
+	DISPATCH_BOARD_SIZE(possibilitiesRemainKernel, possibleValues);
 }
 
 /**
- * check if the specified value is in the missing values array. If so, remove the value and shift the remaining values down, terminating with 0.
- * @param val: the value to remove from the array, if present
- * @param arr: the missing values array from which to remove the specified value
- * @param arrLen: the length of the missing values array (not accounting for 0's)
- * @returns: whether the value was found in and removed from the missing values array (true) or not (false)
+ * allocate a possibleValues array with one candidate set per cell
+ * @returns: a dynamically allocated array of boardSize*boardSize candidate sets
  */
-bool checkRemoveValFromMissingList(int val, int* arr, int arrLen) {
-	for (int i = 0; i < arrLen && arr[i] != 0; ++i) {
-		if (val == arr[i]) {
-			// value found: remove it and shift remaining values down
-			for (int k = i+1; k < arrLen && arr[k-1] !=0; ++k)
-				arr[k-1] = arr[k];
-			arr[arrLen-1] = 0;
-			return true;
-		}
-	}
-	return false;
+candidateSet* allocPossibleValues() {
+	return malloc(boardSize*boardSize*sizeof(candidateSet));
 }
 
 /**
- * copy all possible values from pva to pvb
- * @param pva: possible values list to copy from
- * @param pvb: possible values list to copy to
+ * initialize each cell's possible values from the givens on iBoard
+ * @param iBoard: 2d array containing the board data
+ * @param possibleValues: the full possibleValues array to fill in
  */
-void copyPossibleValues(int*** pva, int*** pvb) {
-	for (int row = 0; row < boardSize; ++row) {
-		for (int col = 0; col < boardSize; ++col) {
-			for (int i = 0; i < boardSize; ++i) {
-				pvb[row][col][i] = pva[row][col][i];
-			}
+void initPossibleValues(int** iBoard, candidateSet* possibleValues) {
+	for (int i = 0; i < boardSize; ++i) {
+		for (int r = 0; r < boardSize; ++r) {
+			// unknown cells start with all possible values, known cells start only with the given value
+			possibleValues[i*boardSize + r] = (iBoard[i][r] == 0 ? candAll() : candBit(iBoard[i][r]));
 		}
 	}
 }
@@ -191,220 +301,518 @@ void copyPossibleValues(int*** pva, int*** pvb) {
  * @param iBoard: 2d array containing the board data
  * @param possibleValues: the full possibleValues array
  */
-void copyPossibilitiesToBoard(int** iBoard, int*** possibleValues) {
+void copyPossibilitiesToBoard(int** iBoard, candidateSet* possibleValues) {
 	for (int row = 0; row < boardSize; ++row) {
 		for (int col = 0; col < boardSize; ++col) {
 			// if the current cell has more than one possible value, insert a 0 to signify that the cell is unknown
-			iBoard[row][col] = (possibleValues[row][col][1] == 0 ? possibleValues[row][col][0] : 0);
+			candidateSet cands = possibleValues[row*boardSize + col];
+			iBoard[row][col] = (candIsSingleton(cands) ? candLowest(cands) : 0);
 		}
 	}
 }
 
+// propagation levels: which rules the CP engine applies (the advanced rules are in cprules.h)
+#define CP_LEVEL_SINGLES 0  // peer elimination and hidden singles only
+#define CP_LEVEL_INTERSECTIONS 1  // adds pointing pairs/triples and box/line reduction
+#define CP_LEVEL_SUBSETS 2  // adds naked and hidden pairs and triples
+#define CP_LEVEL_FISH 3  // adds X-wings
+#define CP_MAX_LEVEL CP_LEVEL_FISH
+
+#define CP_RULE_POINTING 0
+#define CP_RULE_BOX_LINE 1
+#define CP_RULE_NAKED_PAIR 2
+#define CP_RULE_NAKED_TRIPLE 3
+#define CP_RULE_HIDDEN_PAIR 4
+#define CP_RULE_HIDDEN_TRIPLE 5
+#define CP_RULE_X_WING 6
+#define CP_NUM_RULES 7
+
+const char* cpRuleNames[CP_NUM_RULES] = {"pointing", "box/line", "naked pair", "naked triple", "hidden pair", "hidden triple", "X-wing"};
+int cpLevel = CP_LEVEL_SUBSETS;  // which rules propagation applies; every rank must use the same level
+long long totalRuleHits[CP_NUM_RULES];  // successful rule applications on this rank, from every engine as it is freed
+
+// the order in which the serial CP solver picks the cell to branch on, and tries that cell's values
+#define CP_CELLS_MRV 0  // the first cell with the fewest candidates
+#define CP_CELLS_MRV_DEGREE 1  // of the cells with the fewest candidates, the one with the most unsolved peers
+#define CP_CELLS_MRV_RANDOM 2  // of the cells with the fewest candidates, one drawn from this rank's random stream
+#define CP_VALUES_ASCENDING 0
+#define CP_VALUES_LEAST_CONSTRAINING 1  // values possible in the fewest peers first, as they rule out the least
+#define CP_VALUES_RANDOM 2  // drawn from this rank's random stream
+
+int cpCellOrder = CP_CELLS_MRV;
+int cpValueOrder = CP_VALUES_ASCENDING;
+
+// worklist constraint propagation engine shared by the CP solvers; only cells and units touched by a change get re-examined
+typedef struct {
+	int numCells;  // boardSize*boardSize
+	candidateSet* possibleValues;  // one candidate set per cell, indexed by row*boardSize + col
+	int* cellQueue;  // circular queue of cells whose candidates changed since they were last examined
+	bool* cellQueued;
+	int cellQueueHead, cellQueueLen;
+	int* unitQueue;  // stack of units (rows, then columns, then regions) awaiting a hidden single check
+	bool* unitQueued;
+	int unitQueueLen;
+	int* ruleQueue;  // stack of units awaiting the advanced rules enabled by cpLevel
+	bool* ruleQueued;
+	int ruleQueueLen;
+	int* trailCells;  // undo log of (cell, previous candidates) pairs for every change made along the current search path
+	candidateSet* trailValues;
+	int trailLen;
+	uint64_t hash;  // Zobrist hash of the cells that are currently singletons, kept up to date by cpSetCandidates and cpUndo
+	long long nodes;  // search nodes (calls to the internal solver) visited
+	long long propagationVisits;  // cell visits made by the worklist
+	long long sweepVisits;  // cell visits the full-board sweep would have made over the same number of passes
+	long long ruleHits[CP_NUM_RULES];  // successful applications of each advanced rule
+	searchStats stats;  // instrumentation counters, only updated when SOLVER_STATS is defined
+} cpEngine;
+
 /**
- * core recursive internal function for serial constraint propagation solver; recursion branches each time CP can't reduce any further.
+ * queue a cell for re-examination by the propagation engine, if it isn't queued already
+ * @param engine: the propagation engine
+ * @param cell: the index of the cell whose candidates changed
+ */
+void cpEnqueueCell(cpEngine* engine, int cell) {
+	if (engine->cellQueued[cell]) return;
+	engine->cellQueued[cell] = true;
+	int tail = engine->cellQueueHead + engine->cellQueueLen++;
+	engine->cellQueue[tail < engine->numCells ? tail : tail - engine->numCells] = cell;
+}
+
+/**
+ * queue a unit for a hidden single check, if it isn't queued already
+ * @param engine: the propagation engine
+ * @param unit: the index of the unit containing a changed cell
+ */
+void cpEnqueueUnit(cpEngine* engine, int unit) {
+	if (engine->unitQueued[unit]) return;
+	engine->unitQueued[unit] = true;
+	engine->unitQueue[engine->unitQueueLen++] = unit;
+}
+
+/**
+ * queue a unit for the advanced rules, if it isn't queued already
+ * @param engine: the propagation engine
+ * @param unit: the index of the unit containing a changed cell
+ */
+void cpEnqueueRuleUnit(cpEngine* engine, int unit) {
+	if (engine->ruleQueued[unit]) return;
+	engine->ruleQueued[unit] = true;
+	engine->ruleQueue[engine->ruleQueueLen++] = unit;
+}
+
+/**
+ * empty every worklist, such as after propagation reaches a contradiction
+ * @param engine: the propagation engine
+ */
+void cpClearQueues(cpEngine* engine) {
+	for (; engine->cellQueueLen > 0; --engine->cellQueueLen) {
+		engine->cellQueued[engine->cellQueue[engine->cellQueueHead]] = false;
+		if (++engine->cellQueueHead == engine->numCells) engine->cellQueueHead = 0;
+	}
+	while (engine->unitQueueLen > 0)
+		engine->unitQueued[engine->unitQueue[--engine->unitQueueLen]] = false;
+	while (engine->ruleQueueLen > 0)
+		engine->ruleQueued[engine->ruleQueue[--engine->ruleQueueLen]] = false;
+}
+
+/**
+ * change a cell's candidates, recording the previous candidates on the trail so the change can be undone on backtrack
+ * @param engine: the propagation engine
+ * @param cell: the index of the cell to change
+ * @param cands: the cell's new candidate set
+ */
+void cpSetCandidates(cpEngine* engine, int cell, candidateSet cands) {
+	candidateSet old = engine->possibleValues[cell];
+	engine->trailCells[engine->trailLen] = cell;
+	engine->trailValues[engine->trailLen++] = old;
+	engine->possibleValues[cell] = cands;
+	STAT_ADD(engine->stats, eliminations, candCount(old & ~cands));
+	if (candIsSingleton(old)) engine->hash ^= zobristKey(cell, old);
+	if (candIsSingleton(cands)) engine->hash ^= zobristKey(cell, cands);
+}
+
+/**
+ * roll back every candidate change recorded on the trail since the specified mark
+ * @param engine: the propagation engine
+ * @param trailMark: the trail length to return to, as read from engine->trailLen before the changes were made
+ */
+void cpUndo(cpEngine* engine, int trailMark) {
+	while (engine->trailLen > trailMark) {
+		--engine->trailLen;
+		int cell = engine->trailCells[engine->trailLen];
+		candidateSet cur = engine->possibleValues[cell], old = engine->trailValues[engine->trailLen];
+		if (candIsSingleton(cur)) engine->hash ^= zobristKey(cell, cur);
+		if (candIsSingleton(old)) engine->hash ^= zobristKey(cell, old);
+		engine->possibleValues[cell] = old;
+	}
+}
+
+/**
+ * recompute the engine's state hash from scratch, such as after its candidates are replaced wholesale
+ * @param engine: the propagation engine
+ */
+void cpRehash(cpEngine* engine) {
+	engine->hash = 0;
+	for (int i = 0; i < engine->numCells; ++i)
+		if (candIsSingleton(engine->possibleValues[i]))
+			engine->hash ^= zobristKey(i, engine->possibleValues[i]);
+}
+
+/**
+ * replace the engine's candidates wholesale, such as with a stolen or queued subproblem; the trail is reset and every cell is queued
+ * @param engine: the propagation engine
+ * @param possibleValues: the candidate sets to load (which may already be the engine's own array)
+ */
+void cpLoadState(cpEngine* engine, candidateSet* possibleValues) {
+	if (possibleValues != engine->possibleValues)
+		memcpy(engine->possibleValues, possibleValues, engine->numCells*sizeof(candidateSet));
+	engine->trailLen = 0;
+	cpRehash(engine);
+	cpClearQueues(engine);
+	for (int i = 0; i < engine->numCells; ++i)
+		cpEnqueueCell(engine, i);
+}
+
+/**
+ * allocate the propagation engine and load the givens from iBoard; every cell starts out queued
+ * @param engine: the propagation engine to initialize
  * @param iBoard: 2d array containing the board data
- * @param possibleValues: the full possibleValues array
- * @returns: whether this branch led to a solution (true) or not (false)
  */
-bool serialCPSolverInternal(int** iBoard, int*** possibleValues) {
-	// run constraint propagation until each cell has only 0-1 possiblities remaining, or until no new singletons may be created with CP
-	bool createdNewSingleton = true;
-	while (createdNewSingleton && possibilitiesRemain(possibleValues)) {
-		createdNewSingleton = false;
-		for (int row = 0; row < boardSize; ++row) {
-			for (int col = 0; col < boardSize; ++col) {
-				// skip cells that are already completed
-				if (possibleValues[row][col][1] == 0)
-					continue;
-				// apply CP rule 1 (remove peer known values from the current cell's possibility values list)
-				for (int i = 0; i < numPeers; ++i) {
-					int peerRow = peers[row][col][i][0], peerCol = peers[row][col][i][1];
-					if (possibleValues[peerRow][peerCol][1] == 0) {
-						removePossibleValue(possibleValues, row, col, possibleValues[peerRow][peerCol][0]);
-					}
-				}
-				// apply CP rule 2 (choose value if all peers have removed it from their possibility list)
-				// start with an array considering all values as missing
-				int peersMissingValues[boardSize];
-				for (int i = 0; i < boardSize; ++i)
-					peersMissingValues[i] = i+1;
-
-				// for each peer, take values out of the missing array if that peer isn't missing the value
-				for (int i = 0; i < numPeers; ++i) {
-					int peerRow = peers[row][col][i][0], peerCol = peers[row][col][i][1];
-					// iterate over all possible values in current peer
-					for (int r = 0; r < boardSize && possibleValues[peerRow][peerCol][r] != 0; ++r) {
-						checkRemoveValFromMissingList(possibleValues[peerRow][peerCol][r],peersMissingValues,boardSize);
-						if (peersMissingValues[0] == 0) break;
-					}
-					if (peersMissingValues[0] == 0) break;
-				}
-				// we found a value that was missing in all of our peers, so it must be our value
-				if (peersMissingValues[0] != 0) {
-					possibleValues[row][col][0] = peersMissingValues[0];
-					possibleValues[row][col][1] = 0;
-					// we created a new singleton (cell with only 1 possible value), so we can keep running CP
-					createdNewSingleton = true;
-				}
-			}
-		}
+void cpEngineInit(cpEngine* engine, int** iBoard) {
+	int numCells = engine->numCells = boardSize*boardSize;
+	engine->possibleValues = allocPossibleValues();
+	engine->cellQueue = malloc(numCells*sizeof(int));
+	engine->cellQueued = calloc(numCells, sizeof(bool));
+	engine->unitQueue = malloc(3*boardSize*sizeof(int));
+	engine->unitQueued = calloc(3*boardSize, sizeof(bool));
+	engine->ruleQueue = malloc(3*boardSize*sizeof(int));
+	engine->ruleQueued = calloc(3*boardSize, sizeof(bool));
+	// every change removes at least one value from a cell, so a single search path can never trail more than boardSize changes per cell
+	engine->trailCells = malloc(numCells*boardSize*sizeof(int));
+	engine->trailValues = malloc(numCells*boardSize*sizeof(candidateSet));
+	engine->cellQueueHead = engine->cellQueueLen = engine->unitQueueLen = engine->ruleQueueLen = engine->trailLen = 0;
+	engine->nodes = engine->propagationVisits = engine->sweepVisits = 0;
+	memset(engine->ruleHits, 0, sizeof(engine->ruleHits));
+	memset(&engine->stats, 0, sizeof(searchStats));
+
+	initPossibleValues(iBoard, engine->possibleValues);
+	cpRehash(engine);
+	for (int i = 0; i < numCells; ++i)
+		cpEnqueueCell(engine, i);
+}
+
+/**
+ * free the memory held by the propagation engine, adding its work counters to this rank's totals
+ * @param engine: the propagation engine to free
+ */
+void cpEngineFree(cpEngine* engine) {
+	totalNodes += engine->nodes;
+	totalPropagationVisits += engine->propagationVisits;
+	totalSweepVisits += engine->sweepVisits;
+	for (int i = 0; i < CP_NUM_RULES; ++i)
+		totalRuleHits[i] += engine->ruleHits[i];
+	statsMerge(&rankStats, &engine->stats);
+	free(engine->possibleValues);
+	free(engine->cellQueue);
+	free(engine->cellQueued);
+	free(engine->unitQueue);
+	free(engine->unitQueued);
+	free(engine->ruleQueue);
+	free(engine->ruleQueued);
+	free(engine->trailCells);
+	free(engine->trailValues);
+}
+
+/**
+ * apply the hidden single rule to a unit: any value that fits in only one of the unit's cells must go there
+ * @param n: the board size, a compile-time constant in each specialized copy
+ * @param engine: the propagation engine
+ * @param unit: the index of the unit to check (rows, then columns, then regions)
+ * @returns: whether the unit is still consistent (true) or a contradiction was found (false)
+ */
+SIZED_KERNEL bool cpCheckUnitKernel(const int n, cpEngine* engine, int unit) {
+	candidateSet* possibleValues = engine->possibleValues;
+	uint16_t* unitCells = &units[unit*n];
+	// find the values possible in at least one cell, and the values possible in more than one cell
+	candidateSet atLeastOnce = 0, moreThanOnce = 0;
+	for (int k = 0; k < n; ++k) {
+		candidateSet cands = possibleValues[unitCells[k]];
+		moreThanOnce |= atLeastOnce & cands;
+		atLeastOnce |= cands;
 	}
+	engine->propagationVisits += n;
+	// a value with nowhere left to go in this unit is a contradiction
+	if (atLeastOnce != candAllSized(n))
+		return false;
 
-	// if we have reduced all cell possibilities to singletons, we have either a solution or a contradiction
-	if (!possibilitiesRemain(possibleValues)) {
-		copyPossibilitiesToBoard(iBoard,possibleValues);
-		return boardIsSolved(iBoard);
+	candidateSet exactlyOnce = atLeastOnce & ~moreThanOnce;
+	for (int k = 0; k < n && exactlyOnce != 0; ++k) {
+		int cell = unitCells[k];
+		candidateSet hidden = possibleValues[cell] & exactlyOnce;
+		if (hidden == 0 || hidden == possibleValues[cell])
+			continue;
+		// two values that can each only go in this cell is a contradiction
+		if (!candIsSingleton(hidden))
+			return false;
+		cpSetCandidates(engine, cell, hidden);
+		cpEnqueueCell(engine, cell);
 	}
+	return true;
+}
 
-	// if any cells have no possibilities, we've reached a contradiction
-	for (int row = 0; row < boardSize; ++row) {
-		for (int col = 0; col < boardSize; ++col) {
-			if (possibleValues[row][col][0] == 0)
+#include "cprules.h"
+
+/**
+ * run constraint propagation from the queued cells until no new singletons may be created.
+ * rule 1 removes a new singleton's value from its peers; rule 2 (hidden single) is checked on each unit containing a changed cell.
+ * once neither rule has anything left to do, the advanced rules enabled by cpLevel are applied to each unit containing a changed cell.
+ * @param n: the board size, a compile-time constant in each specialized copy
+ * @param k: the region size, a compile-time constant in each specialized copy
+ * @param engine: the propagation engine
+ * @returns: whether propagation finished without a contradiction (true) or some cell or unit ran out of values (false)
+ */
+SIZED_KERNEL bool cpPropagateKernel(const int n, const int k, cpEngine* engine) {
+	candidateSet* possibleValues = engine->possibleValues;
+	const int numCells = n*n;
+	const int peersPerCell = 3*n - 2*k - 1;
+	while (engine->cellQueueLen > 0 || engine->unitQueueLen > 0 || engine->ruleQueueLen > 0) {
+		// the advanced rules cost more per unit, so they only run once the basic rules are at their fixpoint
+		if (engine->cellQueueLen == 0 && engine->unitQueueLen == 0) {
+			int unit = engine->ruleQueue[--engine->ruleQueueLen];
+			engine->ruleQueued[unit] = false;
+			if (!cpApplyRulesKernel(n, k, engine, unit)) {
+				cpClearQueues(engine);
 				return false;
+			}
+			continue;
 		}
-	}
 
-	// find the cell with the fewest possibilities
-	int fewestRow = -1, fewestCol = -1;
-	int fewestPossibilities = boardSize+1;
-	for (int row = 0; row < boardSize; ++row) {
-		for (int col = 0; col < boardSize; ++col) {
-			// possible candidate
-			if (possibleValues[row][col][1] != 0) {
-				int curPossibilities = 0;
-				for (int k = 0; k < boardSize && possibleValues[row][col][k] != 0; ++k, ++curPossibilities);
-				// found a new cell with the fewest possibilities
-				if (curPossibilities < fewestPossibilities) {
-					fewestPossibilities = curPossibilities;
-					fewestRow = row;
-					fewestCol = col;
+		// each round stands in for one pass of the old loop, which examined every cell against every peer
+		engine->sweepVisits += (long long)numCells*peersPerCell;
+
+		// examine the cells queued so far; cells changed along the way are picked up by the next round
+		for (int remaining = engine->cellQueueLen; remaining > 0; --remaining) {
+			int cell = engine->cellQueue[engine->cellQueueHead];
+			if (++engine->cellQueueHead == numCells) engine->cellQueueHead = 0;
+			--engine->cellQueueLen;
+			engine->cellQueued[cell] = false;
+
+			candidateSet cands = possibleValues[cell];
+			if (cands == 0) {
+				cpClearQueues(engine);
+				return false;
+			}
+			// apply CP rule 1 (remove a known value from each of its peers' possibility lists)
+			if (candIsSingleton(cands)) {
+				uint16_t* cellPeers = &peers[cell*peersPerCell];
+				for (int i = 0; i < peersPerCell; ++i) {
+					int peer = cellPeers[i];
+					if (possibleValues[peer] & cands) {
+						cpSetCandidates(engine, peer, possibleValues[peer] & ~cands);
+						cpEnqueueCell(engine, peer);
+					}
 				}
+				engine->propagationVisits += peersPerCell;
+			}
+			for (int u = 0; u < 3; ++u)
+				cpEnqueueUnit(engine, cellUnits[cell*3 + u]);
+			if (cpLevel > CP_LEVEL_SINGLES) {
+				for (int u = 0; u < 3; ++u)
+					cpEnqueueRuleUnit(engine, cellUnits[cell*3 + u]);
+			}
+		}
+
+		// apply CP rule 2 (choose value if all of a unit's other cells have removed it from their possibility list)
+		while (engine->unitQueueLen > 0) {
+			int unit = engine->unitQueue[--engine->unitQueueLen];
+			engine->unitQueued[unit] = false;
+			if (!cpCheckUnitKernel(n, engine, unit)) {
+				cpClearQueues(engine);
+				return false;
 			}
 		}
 	}
-	// copy the full possibilities list as we might have to undo future decisions if this branch is unsuccessful
-	int*** possibleValuesCopy = alloc_3d_int(boardSize,boardSize,boardSize);
-	copyPossibleValues(possibleValues, possibleValuesCopy);
-	// recurse on the cell with the fewest possibilities for each potential possibility
-	for (int i = 0; i < fewestPossibilities; ++i) {
-		possibleValues[fewestRow][fewestCol][0] = possibleValuesCopy[fewestRow][fewestCol][i];
-		possibleValues[fewestRow][fewestCol][1] = 0;
-		if (serialCPSolverInternal(iBoard, possibleValues)) {
-			dealloc_3d_int(boardSize, possibleValuesCopy);
-			return true;
+	return true;
+}
+
+/**
+ * run constraint propagation from the queued cells using the kernel specialized for the current board size
+ * @param engine: the propagation engine
+ * @returns: whether propagation finished without a contradiction (true) or some cell or unit ran out of values (false)
+ */
+static inline bool cpPropagateSized(cpEngine* engine) {
+	DISPATCH_BOARD_SIZE(cpPropagateKernel, engine);
+}
+
+/**
+ * run constraint propagation from the queued cells, counting and timing each call when instrumentation is compiled in
+ * @param engine: the propagation engine
+ * @returns: whether propagation finished without a contradiction (true) or some cell or unit ran out of values (false)
+ */
+bool cpPropagate(cpEngine* engine) {
+	STAT_ADD(engine->stats, propagations, 1);
+	STAT_TIMER_START(startTime);
+	bool consistent = cpPropagateSized(engine);
+	STAT_TIMER_ADD(engine->stats, propagateTime, startTime);
+	return consistent;
+}
+
+/**
+ * find the unsolved cell with the fewest remaining possibilities
+ * @param n: the board size, a compile-time constant in each specialized copy
+ * @param k: the region size (unused; present to match the other sized kernels)
+ * @param possibleValues: the full possibleValues array
+ * @returns: the index (row*boardSize + col) of the cell with the fewest possibilities, or -1 if no cell has more than one
+ */
+SIZED_KERNEL int fewestPossibilitiesCellKernel(const int n, const int k, candidateSet* possibleValues) {
+	int fewestCell = -1;
+	int fewestPossibilities = n+1;
+	for (int i = 0; i < n*n; ++i) {
+		int curPossibilities = candCount(possibleValues[i]);
+		// found a new cell with the fewest possibilities
+		if (curPossibilities > 1 && curPossibilities < fewestPossibilities) {
+			fewestPossibilities = curPossibilities;
+			fewestCell = i;
+			// two is the best we can do, so stop looking
+			if (curPossibilities == 2) break;
 		}
-		// branch was unsuccessful; revert possible values and try the next branch
-		copyPossibleValues(possibleValuesCopy, possibleValues);
 	}
+	return fewestCell;
+}
 
-	// all branches failed; a previous guess must have been wrong
-	dealloc_3d_int(boardSize, possibleValuesCopy);
-	return false;
+/**
+ * find the unsolved cell with the fewest remaining possibilities using the kernel specialized for the current board size
+ * @param possibleValues: the full possibleValues array
+ * @returns: the index (row*boardSize + col) of the cell with the fewest possibilities, or -1 if no cell has more than one
+ */
+int fewestPossibilitiesCell(candidateSet* possibleValues) {
+	DISPATCH_BOARD_SIZE(fewestPossibilitiesCellKernel, possibleValues);
 }
 
 /**
- * solve the specified board serially using constraint propagation to determine missing values.
- * @param iBoard: 2d array containing the board data
+ * find the unsolved cell with the fewest remaining possibilities, breaking ties toward the cell with the most unsolved peers
+ * @param n: the board size, a compile-time constant in each specialized copy
+ * @param k: the region size (unused; present to match the other sized kernels)
+ * @param possibleValues: the full possibleValues array
+ * @returns: the index (row*boardSize + col) of the chosen cell, or -1 if no cell has more than one possibility
  */
-bool serialCPSolver(int** iBoard) {
-	// init possibility values for each cell
-	int*** possibleValues = alloc_3d_int(boardSize,boardSize,boardSize);
-	for (int i = 0; i < boardSize; ++i) {
-		for (int r = 0; r < boardSize; ++r) {
-			// current cell is unknown: start will all possible values
-			if (iBoard[i][r] == 0) {
-				for (int k = 0; k < boardSize; ++k) {
-					possibleValues[i][r][k] = k+1;
-				}
-			}
-			// current cell is known: start only with the given value
-			else {
-				possibleValues[i][r][0] = iBoard[i][r];
-				possibleValues[i][r][1] = 0;
-			}
+SIZED_KERNEL int mostConstrainedCellKernel(const int n, const int k, candidateSet* possibleValues) {
+	int fewestCell = fewestPossibilitiesCellKernel(n, k, possibleValues);
+	if (fewestCell == -1)
+		return -1;
+	int fewestPossibilities = candCount(possibleValues[fewestCell]), bestDegree = -1;
+	for (int i = fewestCell; i < n*n; ++i) {
+		if (candCount(possibleValues[i]) != fewestPossibilities) continue;
+		int degree = 0;
+		for (int p = 0; p < numPeers; ++p)
+			degree += !candIsSingleton(possibleValues[peers[i*numPeers + p]]);
+		if (degree > bestDegree) {
+			bestDegree = degree;
+			fewestCell = i;
 		}
 	}
+	return fewestCell;
+}
 
-	// run the core recursive CP solver method
-	serialCPSolverInternal(iBoard, possibleValues);
+/**
+ * find the unsolved cell with the fewest remaining possibilities, breaking ties at random
+ * @param n: the board size, a compile-time constant in each specialized copy
+ * @param k: the region size (unused; present to match the other sized kernels)
+ * @param possibleValues: the full possibleValues array
+ * @returns: the index (row*boardSize + col) of the chosen cell, or -1 if no cell has more than one possibility
+ */
+SIZED_KERNEL int randomFewestCellKernel(const int n, const int k, candidateSet* possibleValues) {
+	int fewestCell = -1, fewestPossibilities = n+1, numTied = 0;
+	for (int i = 0; i < n*n; ++i) {
+		int curPossibilities = candCount(possibleValues[i]);
+		if (curPossibilities <= 1 || curPossibilities > fewestPossibilities) continue;
+		if (curPossibilities < fewestPossibilities) {
+			fewestPossibilities = curPossibilities;
+			numTied = 0;
+		}
+		// reservoir sampling: each of the tied cells seen so far is kept with equal probability
+		if (randNext() % ++numTied == 0)
+			fewestCell = i;
+	}
+	return fewestCell;
+}
 
-	// apply resulting values to iBoard
-	copyPossibilitiesToBoard(iBoard, possibleValues);
-	dealloc_3d_int(boardSize,possibleValues);
-	return true;
+/**
+ * choose the cell for the serial CP solver to branch on, as set by cpCellOrder
+ * @param possibleValues: the full possibleValues array
+ * @returns: the index (row*boardSize + col) of the chosen cell, or -1 if no cell has more than one possibility
+ */
+int cpChooseCell(candidateSet* possibleValues) {
+	if (cpCellOrder == CP_CELLS_MRV_DEGREE) {
+		DISPATCH_BOARD_SIZE(mostConstrainedCellKernel, possibleValues);
+	}
+	if (cpCellOrder == CP_CELLS_MRV_RANDOM) {
+		DISPATCH_BOARD_SIZE(randomFewestCellKernel, possibleValues);
+	}
+	return fewestPossibilitiesCell(possibleValues);
 }
 
 /**
- * check if the specified board exists in the board copy array
- * @param iBoard: the board whose presence we wish to check for
- * @param boardCopies: the array of boards we wish to search
- * @returns: whether a board matching iBoard eexists in boardCopies (true) or not (false)
+ * list a cell's possible values in the order the serial CP solver should try them, as set by cpValueOrder
+ * @param possibleValues: the full possibleValues array
+ * @param cell: the index of the cell to branch on
+ * @param order: filled with one single-value candidate set per possibility, in the order to try them
+ * @returns: the number of possibilities listed
  */
-bool boardInBoardCopies(int** iBoard, int*** boardCopies) {
-	for (int bn = 0; bn < numBoards; ++bn) {
-		for (int i = 0; i < boardSize; ++i) {
-			for (int r = 0; r < boardSize; ++r) {
-				if (iBoard[i][r] != boardCopies[bn][i][r]) {
-					goto increment;
-				}
+int cpOrderValues(candidateSet* possibleValues, int cell, candidateSet* order) {
+	int numValues = 0;
+	for (candidateSet remaining = possibleValues[cell]; remaining != 0; remaining &= remaining-1)
+		order[numValues++] = remaining & -remaining;
+	if (cpValueOrder == CP_VALUES_RANDOM) {
+		for (int i = numValues-1; i > 0; --i) {
+			int j = randNext() % (i+1);
+			candidateSet swp = order[i];
+			order[i] = order[j];
+			order[j] = swp;
+		}
+	}
+	else if (cpValueOrder == CP_VALUES_LEAST_CONSTRAINING) {
+		// count the peers each value would be removed from, then insertion sort by that count
+		int constrains[numValues];
+		for (int v = 0; v < numValues; ++v) {
+			constrains[v] = 0;
+			for (int p = 0; p < numPeers; ++p)
+				constrains[v] += (possibleValues[peers[cell*numPeers + p]] & order[v]) != 0;
+		}
+		for (int v = 1; v < numValues; ++v) {
+			candidateSet val = order[v];
+			int count = constrains[v], w = v;
+			for (; w > 0 && constrains[w-1] > count; --w) {
+				order[w] = order[w-1];
+				constrains[w] = constrains[w-1];
 			}
+			order[w] = val;
+			constrains[w] = count;
 		}
-		return true;
-		increment:;
 	}
-	return false;
+	return numValues;
 }
 
 /**
- * core recursive internal function for parallel constraint propagation solver; recursion branches each time CP can't reduce any further.
+ * core recursive internal function for serial constraint propagation solver; recursion branches each time CP can't reduce any further.
  * @param iBoard: 2d array containing the board data
- * @param possibleValues: the full possibleValues array
- * @param boardCopies: array containing subtrees that have already been recursed by another thread
+ * @param engine: the propagation engine holding the full possibleValues array, with the cells changed by the last decision queued
  * @returns: whether this branch led to a solution (true) or not (false)
  */
-bool parallelCPSolverInternal(int** iBoard, int*** possibleValues, int*** boardCopies) {
-	// run constraint propagation until each cell has only 0-1 possiblities remaining, or until no new singletons may be created with CP
-	bool createdNewSingleton = true;
-	while (createdNewSingleton && possibilitiesRemain(possibleValues)) {
-		createdNewSingleton = false;
-		for (int row = 0; row < boardSize; ++row) {
-			for (int col = 0; col < boardSize; ++col) {
-				// skip cells that are already completed
-				if (possibleValues[row][col][1] == 0)
-					continue;
-				// apply CP rule 1 (remove peer known values from the current cell's possibility values list)
-				for (int i = 0; i < numPeers; ++i) {
-					int peerRow = peers[row][col][i][0], peerCol = peers[row][col][i][1];
-					if (possibleValues[peerRow][peerCol][1] == 0) {
-						removePossibleValue(possibleValues, row, col, possibleValues[peerRow][peerCol][0]);
-					}
-				}
-				// apply CP rule 2 (choose value if all peers have removed it from their possibility list)
-				// start with an array considering all values as missing
-				int peersMissingValues[boardSize];
-				for (int i = 0; i < boardSize; ++i)
-					peersMissingValues[i] = i+1;
-
-				// for each peer, take values out of the missing array if that peer isn't missing the value
-				for (int i = 0; i < numPeers; ++i) {
-					int peerRow = peers[row][col][i][0], peerCol = peers[row][col][i][1];
-					// iterate over all possible values in current peer
-					for (int r = 0; r < boardSize && possibleValues[peerRow][peerCol][r] != 0; ++r) {
-						checkRemoveValFromMissingList(possibleValues[peerRow][peerCol][r],peersMissingValues,boardSize);
-						if (peersMissingValues[0] == 0) break;
-					}
-					if (peersMissingValues[0] == 0) break;
-				}
-				// we found a value that was missing in all of our peers, so it must be our value
-				if (peersMissingValues[0] != 0) {
-					possibleValues[row][col][0] = peersMissingValues[0];
-					possibleValues[row][col][1] = 0;
-					// we created a new singleton (cell with only 1 possible value), so we can keep running CP
-					createdNewSingleton = true;
-				}
-			}
-		}
+bool serialCPSolverInternal(int** iBoard, cpEngine* engine) {
+	candidateSet* possibleValues = engine->possibleValues;
+	++engine->nodes;
+	// stop early if another rank has already found a solution
+	if (cancelRequested())
+		return false;
+	// in a restarting search, give up on this run once it reaches its node limit
+	if (restartNodeLimit > 0 && engine->nodes >= restartNodeLimit) {
+		restartAborted = true;
+		return false;
 	}
+	// run constraint propagation from the changed cells until no new singletons may be created; a cell or unit running out of values is a contradiction
+	if (!cpPropagate(engine))
+		return false;
 
 	// if we have reduced all cell possibilities to singletons, we have either a solution or a contradiction
 	if (!possibilitiesRemain(possibleValues)) {
@@ -412,110 +820,208 @@ bool parallelCPSolverInternal(int** iBoard, int*** possibleValues, int*** boardC
 		return boardIsSolved(iBoard);
 	}
 
-	// if any cells have no possibilities, we've reached a contradiction
-	for (int row = 0; row < boardSize; ++row) {
-		for (int col = 0; col < boardSize; ++col) {
-			if (possibleValues[row][col][0] == 0)
-				return false;
+	// skip states whose subtrees have already been refuted
+	if (exploredSetContains(engine->hash))
+		return false;
+	long long startNodes = engine->nodes;
+
+	// find the cell with the fewest possibilities, and the order to try them in
+	int fewestCell = cpChooseCell(possibleValues);
+	candidateSet order[64];
+	int numValues = cpOrderValues(possibleValues, fewestCell, order);
+
+	// remember where the trail stands, as we might have to undo future decisions if this branch is unsuccessful
+	int trailMark = engine->trailLen;
+	STAT_ADD(engine->stats, depth, 1);
+	STAT_MAX(engine->stats, maxDepth, engine->stats.depth);
+	// recurse on the cell with the fewest possibilities for each potential possibility
+	for (int v = 0; v < numValues; ++v) {
+		int lit = fewestCell*boardSize + candLowest(order[v]) - 1;
+		// skip values that an earlier run of a restarting search has already refuted
+		if (numNogoods > 0 && restartNodeLimit > 0 && nogoodViolated(possibleValues, lit)) {
+			++totalNogoodPrunes;
+			continue;
 		}
+		if (restartDepth < NOGOOD_MAX_SIZE)
+			restartPath[restartDepth] = lit;
+		++restartDepth;
+		cpSetCandidates(engine, fewestCell, order[v]);
+		cpEnqueueCell(engine, fewestCell);
+		bool solved = serialCPSolverInternal(iBoard, engine);
+		--restartDepth;
+		if (solved)
+			return true;
+		// branch was unsuccessful; revert possible values and try the next branch
+		cpUndo(engine, trailMark);
+		STAT_ADD(engine->stats, backtracks, 1);
+		if (restartAborted)
+			break;
 	}
+	STAT_ADD(engine->stats, depth, -1);
 
-	// find the cell with the fewest possibilities
-	int fewestRow = -1, fewestCol = -1;
-	int fewestPossibilities = boardSize+1;
-	for (int row = 0; row < boardSize; ++row) {
-		for (int col = 0; col < boardSize; ++col) {
-			// possible candidate
-			if (possibleValues[row][col][1] != 0) {
-				int curPossibilities = 0;
-				for (int k = 0; k < boardSize && possibleValues[row][col][k] != 0; ++k, ++curPossibilities);
-				// found a new cell with the fewest possibilities
-				if (curPossibilities < fewestPossibilities) {
-					fewestPossibilities = curPossibilities;
-					fewestRow = row;
-					fewestCol = col;
-				}
-			}
-		}
+	// all branches failed; a previous guess must have been wrong (unless we were cancelled or ran out of nodes partway, in which
+	// case nothing was refuted). a restarting search also remembers short refuted paths for its later runs
+	if (!cancelSeen && !restartAborted) {
+		exploredSetInsert(engine->hash, engine->nodes - startNodes);
+		if (restartNodeLimit > 0 && restartDepth > 0 && restartDepth <= cpNogoodSize)
+			nogoodRecord(restartPath, restartDepth);
 	}
+	return false;
+}
 
-	//check if we received a board asynchronously from any other rank
-	int flag = 0;
-	MPI_Status status;
-	MPI_Iprobe(MPI_ANY_SOURCE,0,MPI_COMM_WORLD,&flag,&status);
-	if (flag) {
-		// we're ready to receive a board; load it in and add it to our board list
-		MPI_Recv(&(boardCopies[numBoards++][0][0]), boardSize*boardSize, MPI_INT, MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &status );
+/**
+ * run the serial CP search in restarts: each run gives up after the next Luby term times cpRestartUnit nodes and starts over from
+ * the root, with ties between equally constrained cells broken at random and with the nogoods of earlier runs kept
+ * @param iBoard: 2d array containing the board data
+ * @param engine: the propagation engine, loaded with the board
+ * @returns: whether a run found a solution (true) or one searched the whole tree without finding any, or was cancelled (false)
+ */
+bool serialCPSolverRestarts(int** iBoard, cpEngine* engine) {
+	int savedCellOrder = cpCellOrder;
+	if (cpCellOrder == CP_CELLS_MRV)
+		cpCellOrder = CP_CELLS_MRV_RANDOM;
+	nogoodReset();
+	bool solved = false;
+	for (long long run = 1; !cancelSeen; ++run) {
+		restartAborted = false;
+		restartDepth = 0;
+		restartNodeLimit = engine->nodes + lubyTerm(run)*cpRestartUnit;
+		solved = serialCPSolverInternal(iBoard, engine);
+		if (solved || !restartAborted)
+			break;
+		++totalRestarts;
 	}
+	restartNodeLimit = 0;
+	restartAborted = false;
+	cpCellOrder = savedCellOrder;
+	return solved;
+}
 
-	// copy the full possibilities list as we might have to undo future decisions if this branch is unsuccessful
-	int*** possibleValuesCopy = alloc_3d_int(boardSize,boardSize,boardSize);
-	copyPossibleValues(possibleValues, possibleValuesCopy);
-	// recurse on the cell with the fewest possibilities for each potential possibility
-	for (int i = 0; i < fewestPossibilities; ++i) {
-		possibleValues[fewestRow][fewestCol][0] = possibleValuesCopy[fewestRow][fewestCol][i];
-		possibleValues[fewestRow][fewestCol][1] = 0;
-
-		//skip boards that have already been explored by other ranks
-		copyPossibilitiesToBoard(iBoard, possibleValues);
-		if (!boardInBoardCopies(iBoard, boardCopies)) {
-			// this board hasn't been explored yet; send board to all other ranks before using it
-			for (int curRank = 0; curRank < numRanks; ++curRank) {
-				// skip ourselves
-				if (curRank == rank)
-					continue;
-				MPI_Request curReq;
-				MPI_Isend(&(iBoard[0][0]), boardSize*boardSize, MPI_INT, curRank, 0, MPI_COMM_WORLD, &curReq);
-			}
+/**
+ * solve the specified board serially using constraint propagation to determine missing values.
+ * @param iBoard: 2d array containing the board data
+ * @returns whether a solution was found (true) or not, either because none exists or because another rank found one first (false)
+ */
+bool serialCPSolver(int** iBoard) {
+	// init possibility values for each cell
+	cpEngine engine;
+	cpEngineInit(&engine, iBoard);
 
-			// now recurse as normal
-			if (parallelCPSolverInternal(iBoard, possibleValues, boardCopies)) {
-				dealloc_3d_int(boardSize, possibleValuesCopy);
-				return true;
-			}
-		}
+	// run the core recursive CP solver method
+	STAT_TIMER_START(startTime);
+	bool solved = cpRestartUnit > 0 ? serialCPSolverRestarts(iBoard, &engine) : serialCPSolverInternal(iBoard, &engine);
+	STAT_TIMER_ADD(engine.stats, busyTime, startTime);
 
+	// apply resulting values to iBoard
+	copyPossibilitiesToBoard(iBoard, engine.possibleValues);
+	cpEngineFree(&engine);
+	return solved;
+}
+
+#include "worksteal.h"
+
+/**
+ * core recursive internal function for parallel constraint propagation solver; recursion branches each time CP can't reduce any further.
+ * each branch is recorded as a frame so that idle ranks can steal its untried values while we search below it.
+ * @param iBoard: 2d array containing the board data
+ * @param engine: the propagation engine holding the full possibleValues array, with the cells changed by the last decision queued
+ * @param depth: the number of branches above this node in the current (possibly stolen) subtree
+ * @returns: whether this branch led to a solution (true) or not (false)
+ */
+bool parallelCPSolverInternal(int** iBoard, cpEngine* engine, int depth) {
+	candidateSet* possibleValues = engine->possibleValues;
+	++engine->nodes;
+	// answer steal requests and stop early if the search has ended elsewhere
+	if (stealPoll(engine))
+		return false;
+
+	// run constraint propagation from the changed cells until no new singletons may be created; a cell or unit running out of values is a contradiction
+	if (!cpPropagate(engine))
+		return false;
+
+	// if we have reduced all cell possibilities to singletons, we have either a solution or a contradiction
+	if (!possibilitiesRemain(possibleValues)) {
+		copyPossibilitiesToBoard(iBoard,possibleValues);
+		return boardIsSolved(iBoard);
+	}
+
+	// skip states whose subtrees have already been refuted
+	if (exploredSetContains(engine->hash))
+		return false;
+	long long startNodes = engine->nodes;
+
+	// find the cell with the fewest possibilities, and open a frame for it that other ranks may steal values from
+	int fewestCell = fewestPossibilitiesCell(possibleValues);
+	stealFrame* frame = &stealFrames[depth];
+	frame->cell = fewestCell;
+	frame->untried = possibleValues[fewestCell];
+	frame->trailMark = engine->trailLen;
+	frame->gaveAway = false;
+	stealActiveFrames = depth+1;
+	STAT_MAX(engine->stats, maxDepth, depth+1);
+
+	// recurse on each potential possibility that hasn't been given away
+	while (frame->untried != 0) {
+		candidateSet val = frame->untried & -frame->untried;
+		frame->untried &= ~val;
+		cpSetCandidates(engine, fewestCell, val);
+		cpEnqueueCell(engine, fewestCell);
+		if (parallelCPSolverInternal(iBoard, engine, depth+1))
+			return true;
+		stealActiveFrames = depth+1;
 		// branch was unsuccessful; revert possible values and try the next branch
-		copyPossibleValues(possibleValuesCopy, possibleValues);
+		cpUndo(engine, frame->trailMark);
+		STAT_ADD(engine->stats, backtracks, 1);
+		if (stealTerminated)
+			return false;
 	}
 
-	// all branches failed; a previous guess must have been wrong
-	dealloc_3d_int(boardSize, possibleValuesCopy);
+	// all branches failed; a previous guess must have been wrong (unless another rank took some of them)
+	stealActiveFrames = depth;
+	if (!frame->gaveAway)
+		exploredSetInsert(engine->hash, engine->nodes - startNodes);
 	return false;
 }
 
 /**
  * solve the specified board in parallel using constraint propagation to determine missing values.
+ * rank 0 starts with the full search tree; every other rank starts idle and steals subtrees from busy ranks.
  * @param iBoard: 2d array containing the board data
+ * @returns whether this rank found a solution (true) or not (false)
  */
 bool parallelCPSolver(int** iBoard) {
+	if (numRanks == 1)
+		return serialCPSolver(iBoard);
+
 	// init possibility values for each cell
-	int*** possibleValues = alloc_3d_int(boardSize,boardSize,boardSize);
-	for (int i = 0; i < boardSize; ++i) {
-		for (int r = 0; r < boardSize; ++r) {
-			// current cell is unknown: start will all possible values
-			if (iBoard[i][r] == 0) {
-				for (int k = 0; k < boardSize; ++k) {
-					possibleValues[i][r][k] = k+1;
-				}
-			}
-			// current cell is known: start only with the given value
-			else {
-				possibleValues[i][r][0] = iBoard[i][r];
-				possibleValues[i][r][1] = 0;
-			}
+	cpEngine engine;
+	cpEngineInit(&engine, iBoard);
+	stealInit();
+
+	// search our own subtree, then keep stealing subtrees until a solution is found or every rank runs out of work
+	bool solved = false;
+	bool haveWork = (rank == 0 || stealWaitForWork(&engine));
+	while (haveWork) {
+		STAT_TIMER_START(startTime);
+		bool found = parallelCPSolverInternal(iBoard, &engine, 0);
+		STAT_TIMER_ADD(engine.stats, busyTime, startTime);
+		if (found) {
+			solved = true;
+			stealAnnounceDone(true);
+			break;
 		}
+		haveWork = stealWaitForWork(&engine);
 	}
-
-	int*** boardCopies = alloc_3d_int(maxBoards, boardSize, boardSize);
-
-	// run the core recursive CP solver method
-	parallelCPSolverInternal(iBoard, possibleValues, boardCopies);
-
-	dealloc_3d_int(maxBoards, boardCopies);
+	stealFinish();
 
 	// apply resulting values to iBoard
-	copyPossibilitiesToBoard(iBoard, possibleValues);
-	dealloc_3d_int(boardSize,possibleValues);
-	return true;
+	if (solved)
+		copyPossibilitiesToBoard(iBoard, engine.possibleValues);
+	cpEngineFree(&engine);
+	return solved;
 }
+
+#include "hybrid.h"
+#include "count.h"
+#include "dlx.h"
+#include "portfolio.h"
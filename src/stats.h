@@ -0,0 +1,107 @@
+// search instrumentation: counters for the work each solver does and, in parallel runs, for how evenly that work was spread.
+// they are only compiled in when SOLVER_STATS is defined (make STATS=1); otherwise every STAT_ macro expands to nothing, so the
+// solvers pay nothing for them. engines count into their own searchStats (one per thread in hybrid mode), which are merged into
+// this rank's totals when the engine is freed; rank-wide work such as messages is counted into rankStats directly.
+
+#ifdef SOLVER_STATS
+#define STAT_ADD(stats, field, amount) ((stats).field += (amount))
+#define STAT_MAX(stats, field, value) ((stats).field = (stats).field > (value) ? (stats).field : (value))
+#define STAT_TIMER_START(name) double name = MPI_Wtime()
+#define STAT_TIMER_ADD(stats, field, name) ((stats).field += MPI_Wtime() - (name))
+#else
+#define STAT_ADD(stats, field, amount) ((void)0)
+#define STAT_MAX(stats, field, value) ((void)0)
+#define STAT_TIMER_START(name) ((void)0)
+#define STAT_TIMER_ADD(stats, field, name) ((void)0)
+#endif
+// count one point-to-point or one-sided message sent or received by this rank
+#define STAT_SENT(numBytes) (STAT_ADD(rankStats, messagesSent, 1), STAT_ADD(rankStats, bytesSent, numBytes))
+#define STAT_RECEIVED(numBytes) (STAT_ADD(rankStats, messagesReceived, 1), STAT_ADD(rankStats, bytesReceived, numBytes))
+
+// search work counters; search nodes, duplicate subtree hits and restarts are always counted, in totalNodes, exploredHits and
+// the restart counters
+typedef struct {
+	long long propagations;  // calls to cpPropagate
+	long long eliminations;  // candidate values removed from cells, by propagation or by branching
+	long long backtracks;  // branches that failed and were undone
+	long long depth;  // number of branches open on the current search path
+	long long maxDepth;  // deepest the search path got below the root of any search or stolen subtree
+	double propagateTime;  // seconds spent in cpPropagate
+	double busyTime;  // seconds spent searching, summed over threads
+	long long messagesSent, bytesSent;
+	long long messagesReceived, bytesReceived;
+	long long workers;  // the most threads this rank searched with at once
+} searchStats;
+
+searchStats rankStats;  // this rank's totals
+
+/**
+ * add one set of counters into another, such as when an engine's counters are folded into the rank's totals
+ * @param into: the counters to add to
+ * @param from: the counters to add
+ */
+void statsMerge(searchStats* into, searchStats* from) {
+	into->propagations += from->propagations;
+	into->eliminations += from->eliminations;
+	into->backtracks += from->backtracks;
+	into->maxDepth = into->maxDepth > from->maxDepth ? into->maxDepth : from->maxDepth;
+	into->propagateTime += from->propagateTime;
+	into->busyTime += from->busyTime;
+	into->messagesSent += from->messagesSent;
+	into->bytesSent += from->bytesSent;
+	into->messagesReceived += from->messagesReceived;
+	into->bytesReceived += from->bytesReceived;
+	into->workers = into->workers > from->workers ? into->workers : from->workers;
+}
+
+#ifdef SOLVER_STATS
+#define STATS_PER_RANK 16  // values each rank sends to rank 0 for the report
+
+/**
+ * gather every rank's counters to rank 0 and print them, followed by a load imbalance summary; all ranks must call this together.
+ * idle time is whatever part of the solve each of a rank's threads didn't spend searching, including time waiting for work and
+ * time spent after finishing early while slower ranks were still going.
+ * @param elapsed: this rank's solve time
+ */
+void reportSearchStats(double elapsed) {
+	long long workers = rankStats.workers > 0 ? rankStats.workers : 1;
+	double idle = elapsed*workers - rankStats.busyTime;
+	double local[STATS_PER_RANK] = {totalNodes, rankStats.propagations, rankStats.eliminations, rankStats.backtracks, rankStats.maxDepth,
+		rankStats.propagateTime, rankStats.busyTime, idle > 0 ? idle : 0, rankStats.messagesSent, rankStats.bytesSent,
+		rankStats.messagesReceived, rankStats.bytesReceived, exploredHits, totalRestarts, totalNogoods, totalNogoodPrunes};
+	double* all = rank == 0 ? malloc(STATS_PER_RANK*numRanks*sizeof(double)) : NULL;
+	MPI_Gather(local, STATS_PER_RANK, MPI_DOUBLE, all, STATS_PER_RANK, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+	if (rank != 0)
+		return;
+
+	double sums[STATS_PER_RANK] = {0}, maxBusy = 0, maxDepth = 0;
+	for (int i = 0; i < numRanks; ++i) {
+		double* s = &all[STATS_PER_RANK*i];
+		printf("rank %d stats: %.0f nodes, %.0f propagations, %.0f eliminations, %.0f backtracks, max depth %.0f\n",
+			i, s[0], s[1], s[2], s[3], s[4]);
+		printf("rank %d stats: busy %fs (%fs propagating, %fs branching), idle %fs, sent %.0f messages (%.0f bytes), "
+			"received %.0f messages (%.0f bytes), %.0f duplicate subtree hits\n", i, s[6], s[5], s[6]-s[5], s[7], s[8], s[9], s[10], s[11], s[12]);
+		if (s[13] + s[14] > 0)
+			printf("rank %d stats: %.0f restarts, %.0f nogoods recorded, %.0f values pruned by nogoods\n", i, s[13], s[14], s[15]);
+		for (int k = 0; k < STATS_PER_RANK; ++k)
+			sums[k] += s[k];
+		maxBusy = s[6] > maxBusy ? s[6] : maxBusy;
+		maxDepth = s[4] > maxDepth ? s[4] : maxDepth;
+	}
+	// a perfectly balanced search keeps every rank busy for the same time, for an imbalance of 1
+	double meanBusy = sums[6] / numRanks;
+	printf("search totals: %.0f nodes, %.0f propagations, %.0f eliminations, %.0f backtracks, max depth %.0f, %.0f duplicate subtree hits, "
+		"%.0f restarts, %.0f nogood prunes\n", sums[0], sums[1], sums[2], sums[3], maxDepth, sums[12], sums[13], sums[15]);
+	printf("load balance: busy %fs mean, %fs max (imbalance %.2f), %.1f%% of thread time idle, %.1f%% of busy time propagating, "
+		"%.0f messages (%.0f bytes) sent\n", meanBusy, maxBusy, meanBusy > 0 ? maxBusy / meanBusy : 1,
+		sums[6] + sums[7] > 0 ? 100*sums[7] / (sums[6] + sums[7]) : 0, sums[6] > 0 ? 100*sums[5] / sums[6] : 0, sums[8], sums[9]);
+	free(all);
+}
+#else
+/**
+ * report the search counters; they aren't compiled in, so there is nothing to report
+ * @param elapsed: this rank's solve time
+ */
+void reportSearchStats(double elapsed) {
+}
+#endif
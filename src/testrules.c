@@ -0,0 +1,99 @@
+// propagation rule checks, built and run by make check. the solver is a single translation unit, so this file pulls in
+// generator.c with its main renamed and drives the CP engine directly.
+
+#define main generatorMain
+#include "generator.c"
+#undef main
+
+// a board where pointing in the middle right region (unit 23) removes candidates outside it, after which a naked subset is
+// needed inside the same region before propagation reaches its fixpoint
+const char* pointingThenSubsetBoard = "...1.4...41..2..5.....6...7..9.3.4..7...92..36...1.8.....6.3..4.....9....6....2.8";
+#define POINTING_THEN_SUBSET_OPEN 46  // cells left open at the fixpoint with CP_LEVEL_SUBSETS
+
+int failures = 0;
+
+/**
+ * load a 9x9 board from a line of text, with '.' or '0' for empty cells
+ * @param line: the board's 81 cells, row by row
+ * @returns: whether the line held a full board (true) or not (false)
+ */
+bool loadLine(const char* line) {
+	if (strlen(line) < 81)
+		return false;
+	for (int i = 0; i < 81; ++i)
+		board[i/9][i%9] = line[i] == '.' ? 0 : line[i] - '0';
+	return true;
+}
+
+/**
+ * propagate the current board at the given level, then queue every unit for the advanced rules again and check that another
+ * round of propagation finds nothing more to remove
+ * @param level: the CP_LEVEL_* propagation level
+ * @param name: the board's name, for failure messages
+ * @returns: the number of cells left open at the fixpoint, or -1 if the board has a contradiction
+ */
+int checkFixpoint(int level, const char* name) {
+	cpLevel = level;
+	cpEngine engine;
+	cpEngineInit(&engine, board);
+	int open = -1;
+	if (cpPropagate(&engine)) {
+		candidateSet before[81];
+		memcpy(before, engine.possibleValues, sizeof(before));
+		for (int unit = 0; unit < 3*boardSize; ++unit)
+			cpEnqueueRuleUnit(&engine, unit);
+		if (!cpPropagate(&engine) || memcmp(before, engine.possibleValues, sizeof(before)) != 0) {
+			printf("FAIL %s at level %d: propagation stopped short of its fixpoint\n", name, level);
+			++failures;
+		}
+		open = 0;
+		for (int i = 0; i < 81; ++i)
+			open += !candIsSingleton(before[i]);
+	}
+	cpEngineFree(&engine);
+	return open;
+}
+
+int main(int argc, char** argv) {
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+	boardSize = 9;
+	regionSize = 3;
+	numPeers = 2*(boardSize-1) + regionSize*regionSize - 2*(regionSize-1) - 1;
+	initBoard();
+	initPeers();
+	initExploredSet();
+
+	loadLine(pointingThenSubsetBoard);
+	int open = checkFixpoint(CP_LEVEL_SUBSETS, "pointing then subset board");
+	if (open != POINTING_THEN_SUBSET_OPEN) {
+		printf("FAIL pointing then subset board: %d cells open, expected %d\n", open, POINTING_THEN_SUBSET_OPEN);
+		++failures;
+	}
+
+	// every 9x9 corpus board must reach a true fixpoint at every level
+	const char* corpora[] = {"puzzles/easy.txt", "puzzles/hard.txt", "puzzles/pathological.txt"};
+	int boardsChecked = 1;
+	for (int i = 0; i < 3; ++i) {
+		FILE* f = fopen(corpora[i], "r");
+		if (f == NULL) {
+			printf("FAIL could not open %s\n", corpora[i]);
+			++failures;
+			continue;
+		}
+		char line[256];
+		while (fgets(line, sizeof(line), f)) {
+			if (!loadLine(line))
+				continue;
+			for (int level = CP_LEVEL_INTERSECTIONS; level <= CP_MAX_LEVEL; ++level)
+				checkFixpoint(level, corpora[i]);
+			++boardsChecked;
+		}
+		fclose(f);
+	}
+
+	printf("%s: %d boards checked, %d failures\n", failures == 0 ? "PASS" : "FAIL", boardsChecked, failures);
+	MPI_Finalize();
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
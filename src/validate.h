@@ -0,0 +1,137 @@
+// bitmask validators: the values used in each row, column and region are kept as candidate sets, so checking a placement is O(1)
+// and checking a whole board is a single pass over its cells.
+
+// the values placed in each row, column and region of a board being filled in cell by cell
+typedef struct {
+	candidateSet rowUsed[64];
+	candidateSet colUsed[64];
+	candidateSet regionUsed[64];
+} placementMasks;
+
+/**
+ * get the region containing a cell
+ * @param row: the cell's row
+ * @param col: the cell's column
+ * @returns: the index of the cell's region, counting across then down
+ */
+static inline int regionOf(int row, int col) {
+	return row/regionSize*regionSize + col/regionSize;
+}
+
+/**
+ * load the values already placed on a board into a set of placement masks
+ * @param masks: the masks to fill in
+ * @param iBoard: 2d array containing the board data
+ * @returns: whether the board's values are consistent (true) or some row, column or region repeats a value (false)
+ */
+bool placementMasksInit(placementMasks* masks, int** iBoard) {
+	memset(masks, 0, sizeof(placementMasks));
+	for (int row = 0; row < boardSize; ++row) {
+		for (int col = 0; col < boardSize; ++col) {
+			int val = iBoard[row][col];
+			if (val == 0) continue;
+			candidateSet bit = candBit(val);
+			int region = regionOf(row, col);
+			if ((masks->rowUsed[row] | masks->colUsed[col] | masks->regionUsed[region]) & bit)
+				return false;
+			masks->rowUsed[row] |= bit;
+			masks->colUsed[col] |= bit;
+			masks->regionUsed[region] |= bit;
+		}
+	}
+	return true;
+}
+
+/**
+ * determine whether a value may be placed in an empty cell without repeating a value in its row, column or region
+ * @param masks: the masks of the values placed so far
+ * @param row: the cell's row
+ * @param col: the cell's column
+ * @param val: the value (1..boardSize) to place
+ * @returns: whether the placement is valid (true) or not (false)
+ */
+static inline bool placementAllowed(placementMasks* masks, int row, int col, int val) {
+	return ((masks->rowUsed[row] | masks->colUsed[col] | masks->regionUsed[regionOf(row, col)]) & candBit(val)) == 0;
+}
+
+/**
+ * place a value in an empty cell, recording it in the masks
+ * @param masks: the masks of the values placed so far
+ * @param iBoard: 2d array containing the board data
+ * @param row: the cell's row
+ * @param col: the cell's column
+ * @param val: the value (1..boardSize) to place
+ */
+static inline void placementSet(placementMasks* masks, int** iBoard, int row, int col, int val) {
+	candidateSet bit = candBit(val);
+	masks->rowUsed[row] |= bit;
+	masks->colUsed[col] |= bit;
+	masks->regionUsed[regionOf(row, col)] |= bit;
+	iBoard[row][col] = val;
+}
+
+/**
+ * empty a cell filled by placementSet, removing its value from the masks
+ * @param masks: the masks of the values placed so far
+ * @param iBoard: 2d array containing the board data
+ * @param row: the cell's row
+ * @param col: the cell's column
+ */
+static inline void placementClear(placementMasks* masks, int** iBoard, int row, int col) {
+	candidateSet bit = candBit(iBoard[row][col]);
+	masks->rowUsed[row] &= ~bit;
+	masks->colUsed[col] &= ~bit;
+	masks->regionUsed[regionOf(row, col)] &= ~bit;
+	iBoard[row][col] = 0;
+}
+
+/**
+ * determine whether a board stored one byte per cell is solved. every unit has boardSize cells, so it holds each value exactly once
+ * if and only if the union of its values is every value; this needs no duplicate checks and no branches, so the compiler can
+ * vectorize the loops.
+ * @param n: the board size, a compile-time constant in each specialized copy
+ * @param k: the region size, a compile-time constant in each specialized copy
+ * @param cells: the board's cell values, one byte per cell
+ * @returns: whether the board is solved (true) or not (false)
+ */
+SIZED_KERNEL bool boardCellsAreSolvedKernel(const int n, const int k, const unsigned char* cells) {
+	candidateSet rowUsed[n], colUsed[n], regionUsed[n];
+	for (int i = 0; i < n; ++i)
+		rowUsed[i] = colUsed[i] = regionUsed[i] = 0;
+	int outOfRange = 0;
+	for (int row = 0; row < n; ++row) {
+		for (int col = 0; col < n; ++col) {
+			int val = cells[row*n + col];
+			outOfRange |= val > n;
+			// an empty cell (0) contributes no value
+			candidateSet bit = ((candidateSet)1 << (val & 63)) >> 1;
+			rowUsed[row] |= bit;
+			colUsed[col] |= bit;
+			regionUsed[row/k*k + col/k] |= bit;
+		}
+	}
+	candidateSet all = candAllSized(n), missing = 0;
+	for (int i = 0; i < n; ++i)
+		missing |= (rowUsed[i] & colUsed[i] & regionUsed[i]) ^ all;
+	return !outOfRange && missing == 0;
+}
+
+/**
+ * determine whether each of a batch of boards stored one byte per cell is solved
+ * @param boards: the first board's cell values; each board's cells are stored contiguously
+ * @param stride: the number of bytes from the start of one board to the start of the next
+ * @param numBoards: the number of boards to check
+ * @param solved: filled with whether each board is solved
+ */
+void boardsAreSolved(const unsigned char* boards, size_t stride, int numBoards, bool* solved) {
+	for (int b = 0; b < numBoards; ++b) {
+		const unsigned char* cells = boards + b*stride;
+		switch (boardSize) {
+			case 9: solved[b] = boardCellsAreSolvedKernel(9, 3, cells); break;
+			case 16: solved[b] = boardCellsAreSolvedKernel(16, 4, cells); break;
+			case 25: solved[b] = boardCellsAreSolvedKernel(25, 5, cells); break;
+			case 36: solved[b] = boardCellsAreSolvedKernel(36, 6, cells); break;
+			default: solved[b] = boardCellsAreSolvedKernel(boardSize, regionSize, cells);
+		}
+	}
+}
@@ -0,0 +1,327 @@
+// distributed work-stealing scheduler used by the parallel CP solver.
+// idle ranks ask random victims for work; a busy victim gives away untried values from its shallowest open branch as a serialized
+// candidate state. Termination with no solution is detected with Safra's token algorithm, counting only work messages.
+
+// message tags used by the work-stealing scheduler, all sent on a private duplicate of MPI_COMM_WORLD
+#define STEAL_TAG_REQUEST 1  // thief -> victim: asking for work (no payload)
+#define STEAL_TAG_WORK 2  // victim -> thief: a candidate state to search from (boardSize*boardSize candidate sets)
+#define STEAL_TAG_NONE 3  // victim -> thief: no work to give (no payload)
+#define STEAL_TAG_TOKEN 4  // termination detection token passed around the ring of ranks
+#define STEAL_TAG_DONE 5  // the search is over; payload says whether the sender found a solution
+
+#define STEAL_POLL_INTERVAL 8  // search nodes between checks for incoming scheduler messages
+
+// one open branch of the search: the cell being branched on and the values not yet tried or given away
+typedef struct {
+	int cell;
+	candidateSet untried;
+	int trailMark;  // trail length at this branch, used to rebuild its candidate state when giving values away
+	bool gaveAway;  // some values were given to another rank, so failing here doesn't refute this state
+} stealFrame;
+
+// termination detection token: running sum of work messages sent minus received, and whether any rank it passed was black
+typedef struct {
+	long long count;
+	long long black;
+} stealToken;
+
+// an outgoing message that hasn't yet been received
+typedef struct {
+	MPI_Request request;
+	void* buffer;
+} stealSend;
+
+// per-rank scheduler state
+MPI_Comm stealComm;
+stealFrame* stealFrames;  // open branches of the current search, indexed by depth
+int stealActiveFrames;  // number of frames currently open
+bool stealTerminated;  // the search is over, either because a solution was found somewhere or because every rank ran out of work
+bool stealRequestOutstanding;  // we have asked a victim for work and not yet heard back
+bool stealGotWork;  // a stolen candidate state has been loaded into the engine
+long long stealMessageCount;  // work messages sent minus work messages received (Safra)
+bool stealBlack;  // we have received work since last passing the token (Safra)
+bool stealHoldingToken;
+bool stealTokenCirculating;  // rank 0 only: a token is on its way around the ring
+stealToken stealHeldToken;
+stealSend* stealSends;
+int stealNumSends, stealSendsCapacity;
+unsigned long long stealRandState;
+int stealPollCountdown;
+
+// scheduler counters for this rank
+long long stealRequestsSent = 0;
+long long stealWorkReceived = 0;
+long long stealWorkGiven = 0;
+
+/**
+ * generate the next value from this rank's victim selection generator (xorshift64), independent of rand()
+ * @returns: a pseudorandom 64 bit value
+ */
+unsigned long long stealRand() {
+	stealRandState ^= stealRandState << 13;
+	stealRandState ^= stealRandState >> 7;
+	stealRandState ^= stealRandState << 17;
+	return stealRandState;
+}
+
+/**
+ * send a copy of the specified payload without blocking. synchronous mode is used so that a completed send is known to have been
+ * received, which lets stealFinish confirm that no message is left in flight.
+ * @param payload: the data to send, or NULL for an empty message
+ * @param bytes: the size of the payload
+ * @param dest: the rank to send to
+ * @param tag: the message tag
+ */
+void stealIssend(void* payload, int bytes, int dest, int tag) {
+	if (stealNumSends == stealSendsCapacity)
+		stealSends = realloc(stealSends, (stealSendsCapacity *= 2)*sizeof(stealSend));
+	stealSend* send = &stealSends[stealNumSends++];
+	send->buffer = malloc(bytes > 0 ? bytes : 1);
+	if (bytes > 0)
+		memcpy(send->buffer, payload, bytes);
+	MPI_Issend(send->buffer, bytes, MPI_BYTE, dest, tag, stealComm, &send->request);
+	STAT_SENT(bytes);
+}
+
+/**
+ * free the buffers of any outgoing messages that have been received
+ */
+void stealProgressSends() {
+	for (int i = 0; i < stealNumSends; ++i) {
+		int done;
+		MPI_Test(&stealSends[i].request, &done, MPI_STATUS_IGNORE);
+		if (done) {
+			free(stealSends[i].buffer);
+			stealSends[i--] = stealSends[--stealNumSends];
+		}
+	}
+}
+
+/**
+ * tell every other rank that the search is over
+ * @param foundSolution: whether we are ending the search because we found a solution
+ */
+void stealAnnounceDone(bool foundSolution) {
+	int payload = foundSolution;
+	for (int curRank = 0; curRank < numRanks; ++curRank)
+		if (curRank != rank)
+			stealIssend(&payload, sizeof(int), curRank, STEAL_TAG_DONE);
+	stealTerminated = true;
+}
+
+/**
+ * give the thief untried values from our shallowest open branch, or tell it we have nothing to give
+ * @param engine: the propagation engine holding our current search state
+ * @param thief: the rank asking for work
+ */
+void stealGiveWork(cpEngine* engine, int thief) {
+	int depth = 0;
+	while (depth < stealActiveFrames && stealFrames[depth].untried == 0)
+		++depth;
+	if (depth == stealActiveFrames) {
+		stealIssend(NULL, 0, thief, STEAL_TAG_NONE);
+		return;
+	}
+
+	// give away the upper half of the untried values (at least one), keeping the rest for ourselves
+	stealFrame* frame = &stealFrames[depth];
+	candidateSet given = frame->untried;
+	for (int keep = candCount(given)/2; keep > 0; --keep)
+		given &= given-1;
+	frame->untried &= ~given;
+	frame->gaveAway = true;
+
+	// rebuild the candidate state at the branch by rolling the trail back on a copy, then restrict the branch cell to the given values
+	candidateSet* state = malloc(engine->numCells*sizeof(candidateSet));
+	memcpy(state, engine->possibleValues, engine->numCells*sizeof(candidateSet));
+	for (int t = engine->trailLen-1; t >= frame->trailMark; --t)
+		state[engine->trailCells[t]] = engine->trailValues[t];
+	state[frame->cell] = given;
+	stealIssend(state, engine->numCells*sizeof(candidateSet), thief, STEAL_TAG_WORK);
+	free(state);
+	++stealMessageCount;
+	++stealWorkGiven;
+}
+
+/**
+ * pass the token we are holding on to the next rank in the ring, or on rank 0, decide whether every rank is out of work.
+ * only called while we are idle.
+ */
+void stealForwardToken() {
+	stealHoldingToken = false;
+	if (rank == 0) {
+		stealTokenCirculating = false;
+		// a white token and a white rank 0 with no work messages in flight means no rank can ever become busy again
+		if (!stealHeldToken.black && !stealBlack && stealHeldToken.count + stealMessageCount == 0) {
+			stealAnnounceDone(false);
+			return;
+		}
+	}
+	else {
+		stealHeldToken.count += stealMessageCount;
+		stealHeldToken.black |= stealBlack;
+		stealIssend(&stealHeldToken, sizeof(stealToken), (rank+1) % numRanks, STEAL_TAG_TOKEN);
+	}
+	stealBlack = false;
+}
+
+/**
+ * receive and act on one incoming scheduler message
+ * @param engine: the propagation engine holding our current search state (loaded with stolen work if a work message arrives)
+ * @param status: the probed status of the message to receive
+ */
+void stealHandleMessage(cpEngine* engine, MPI_Status* status) {
+	int bytes;
+	MPI_Get_count(status, MPI_BYTE, &bytes);
+	int source = status->MPI_SOURCE;
+	STAT_RECEIVED(bytes);
+	switch (status->MPI_TAG) {
+		case STEAL_TAG_REQUEST:
+			MPI_Recv(NULL, 0, MPI_BYTE, source, STEAL_TAG_REQUEST, stealComm, MPI_STATUS_IGNORE);
+			if (stealTerminated)
+				break;
+			stealGiveWork(engine, source);
+			break;
+		case STEAL_TAG_WORK:
+			// stolen work replaces our (idle) candidate state wholesale, and every cell is examined afresh
+			MPI_Recv(engine->possibleValues, bytes, MPI_BYTE, source, STEAL_TAG_WORK, stealComm, MPI_STATUS_IGNORE);
+			cpLoadState(engine, engine->possibleValues);
+			--stealMessageCount;
+			stealBlack = true;
+			stealRequestOutstanding = false;
+			stealGotWork = true;
+			++stealWorkReceived;
+			break;
+		case STEAL_TAG_NONE:
+			MPI_Recv(NULL, 0, MPI_BYTE, source, STEAL_TAG_NONE, stealComm, MPI_STATUS_IGNORE);
+			stealRequestOutstanding = false;
+			break;
+		case STEAL_TAG_TOKEN:
+			MPI_Recv(&stealHeldToken, sizeof(stealToken), MPI_BYTE, source, STEAL_TAG_TOKEN, stealComm, MPI_STATUS_IGNORE);
+			stealHoldingToken = true;
+			break;
+		case STEAL_TAG_DONE: {
+			int foundSolution;
+			MPI_Recv(&foundSolution, sizeof(int), MPI_BYTE, source, STEAL_TAG_DONE, stealComm, MPI_STATUS_IGNORE);
+			stealTerminated = true;
+			break;
+		}
+	}
+}
+
+/**
+ * cheaply check for incoming scheduler messages from inside the search, every STEAL_POLL_INTERVAL nodes
+ * @param engine: the propagation engine holding our current search state
+ * @returns: whether the search is over and we should unwind (true) or keep searching (false)
+ */
+bool stealPoll(cpEngine* engine) {
+	if (--stealPollCountdown > 0)
+		return stealTerminated;
+	stealPollCountdown = STEAL_POLL_INTERVAL;
+	int flag;
+	MPI_Status status;
+	MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, stealComm, &flag, &status);
+	while (flag && !stealTerminated) {
+		stealHandleMessage(engine, &status);
+		MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, stealComm, &flag, &status);
+	}
+	stealProgressSends();
+	return stealTerminated;
+}
+
+/**
+ * take one step of the idle protocol: progress outgoing messages, drive termination detection, and ask a random victim for work
+ * if we aren't already waiting on one. only called while we have no work.
+ */
+void stealIdleStep() {
+	stealProgressSends();
+	if (rank == 0 && !stealTokenCirculating && !stealHoldingToken) {
+		// start a new termination detection round
+		stealHeldToken.count = 0;
+		stealHeldToken.black = false;
+		stealBlack = false;
+		stealTokenCirculating = true;
+		stealIssend(&stealHeldToken, sizeof(stealToken), 1, STEAL_TAG_TOKEN);
+	}
+	if (stealHoldingToken) {
+		stealForwardToken();
+		if (stealTerminated)
+			return;
+	}
+	if (!stealRequestOutstanding) {
+		int victim = stealRand() % (numRanks-1);
+		stealIssend(NULL, 0, victim < rank ? victim : victim+1, STEAL_TAG_REQUEST);
+		stealRequestOutstanding = true;
+		++stealRequestsSent;
+	}
+}
+
+/**
+ * wait for work while idle: ask random victims for work, take part in termination detection, and answer other ranks' requests
+ * @param engine: the propagation engine, into which stolen work is loaded
+ * @returns: whether we received work to search (true) or the search is over (false)
+ */
+bool stealWaitForWork(cpEngine* engine) {
+	stealActiveFrames = 0;
+	stealGotWork = false;
+	while (!stealTerminated && !stealGotWork) {
+		stealIdleStep();
+		if (stealTerminated)
+			break;
+		MPI_Status status;
+		MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, stealComm, &status);
+		stealHandleMessage(engine, &status);
+	}
+	return stealGotWork;
+}
+
+/**
+ * set up the scheduler for a new search
+ */
+void stealInit() {
+	MPI_Comm_dup(MPI_COMM_WORLD, &stealComm);
+	stealFrames = malloc(boardSize*boardSize*sizeof(stealFrame));
+	stealActiveFrames = 0;
+	stealTerminated = stealRequestOutstanding = stealGotWork = stealBlack = stealHoldingToken = stealTokenCirculating = false;
+	stealMessageCount = 0;
+	stealSendsCapacity = 16;
+	stealNumSends = 0;
+	stealSends = malloc(stealSendsCapacity*sizeof(stealSend));
+	stealRandState = 0x9E3779B97F4A7C15ULL * (rank+1);
+	stealPollCountdown = STEAL_POLL_INTERVAL;
+}
+
+/**
+ * tear down the scheduler once the search is over, discarding any late messages until every rank's sends have been received
+ */
+void stealFinish() {
+	MPI_Request barrier;
+	bool inBarrier = false;
+	int barrierDone = 0;
+	char discard[64];
+	while (!barrierDone) {
+		// receive and discard anything still addressed to us; work messages can be large, so probe for their size first
+		int flag;
+		MPI_Status status;
+		MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, stealComm, &flag, &status);
+		if (flag) {
+			int bytes;
+			MPI_Get_count(&status, MPI_BYTE, &bytes);
+			void* buffer = bytes > (int)sizeof(discard) ? malloc(bytes) : discard;
+			MPI_Recv(buffer, bytes, MPI_BYTE, status.MPI_SOURCE, status.MPI_TAG, stealComm, MPI_STATUS_IGNORE);
+			STAT_RECEIVED(bytes);
+			if (buffer != discard) free(buffer);
+		}
+		stealProgressSends();
+		// once all of our own sends have been received, join the non-blocking barrier; it completes when every rank has done the same
+		if (!inBarrier && stealNumSends == 0) {
+			MPI_Ibarrier(stealComm, &barrier);
+			inBarrier = true;
+		}
+		if (inBarrier)
+			MPI_Test(&barrier, &barrierDone, MPI_STATUS_IGNORE);
+	}
+	free(stealSends);
+	free(stealFrames);
+	MPI_Comm_free(&stealComm);
+}